@@ -151,18 +151,7 @@ void Autocomplete::setup_dialog() {
 
     on_changed(index, text);
 
-    auto tooltip = get_tooltip(index);
-    if(tooltip.empty())
-      tooltips.hide();
-    else {
-      tooltips.clear();
-      auto iter = CompletionDialog::get()->start_mark->get_iter();
-      tooltips.emplace_back(view, view->get_buffer()->create_mark(iter), view->get_buffer()->create_mark(iter), [tooltip = std::move(tooltip)](const Glib::RefPtr<Gtk::TextBuffer> &buffer) {
-        buffer->insert(buffer->get_insert()->get_iter(), tooltip);
-      });
-
-      tooltips.show(true);
-    }
+    update_tooltip(index);
   };
 
   CompletionDialog::get()->on_select = [this](unsigned int index, const std::string &text, bool hide_window) {
@@ -172,3 +161,18 @@ void Autocomplete::setup_dialog() {
     on_select(index, text, hide_window);
   };
 }
+
+void Autocomplete::update_tooltip(unsigned int index) {
+  auto tooltip = get_tooltip(index);
+  if(tooltip.empty())
+    tooltips.hide();
+  else {
+    tooltips.clear();
+    auto iter = CompletionDialog::get()->start_mark->get_iter();
+    tooltips.emplace_back(view, view->get_buffer()->create_mark(iter), view->get_buffer()->create_mark(iter), [tooltip = std::move(tooltip)](const Glib::RefPtr<Gtk::TextBuffer> &buffer) {
+      buffer->insert(buffer->get_insert()->get_iter(), tooltip);
+    });
+
+    tooltips.show(true);
+  }
+}
@@ -53,6 +53,8 @@ public:
 
   void run();
   void stop();
+  /// Shows the tooltip of the row at index, for instance when the tooltip has changed
+  void update_tooltip(unsigned int index);
 
 private:
   void setup_dialog();
@@ -1,7 +1,9 @@
 #include "compile_commands.h"
 #include "clangmm.h"
+#include "filesystem.h"
+#include "json.h"
 #include <algorithm>
-#include <boost/property_tree/json_parser.hpp>
+#include <fstream>
 #include <regex>
 
 std::vector<std::string> CompileCommands::Command::parameter_values(const std::string &parameter_name) const {
@@ -20,101 +22,342 @@ std::vector<std::string> CompileCommands::Command::parameter_values(const std::s
   return parameter_values;
 }
 
-CompileCommands::CompileCommands(const boost::filesystem::path &build_path) {
+CompileCommands::Database::Database(const boost::filesystem::path &build_path, std::time_t last_write_time) : last_write_time(last_write_time), build_path(build_path) {
   try {
-    boost::property_tree::ptree root_pt;
-    boost::property_tree::json_parser::read_json((build_path / "compile_commands.json").string(), root_pt);
-
-    auto commands_pt = root_pt.get_child("");
-    for(auto &command : commands_pt) {
-      boost::filesystem::path directory = command.second.get<std::string>("directory");
-      auto parameters_str = command.second.get<std::string>("command");
-      boost::filesystem::path file = command.second.get<std::string>("file");
-
-      std::vector<std::string> parameters;
-      bool backslash = false;
-      bool single_quote = false;
-      bool double_quote = false;
-      size_t parameter_start_pos = std::string::npos;
-      size_t parameter_size = 0;
-      auto add_parameter = [&parameters, &parameters_str, &parameter_start_pos, &parameter_size] {
-        auto parameter = parameters_str.substr(parameter_start_pos, parameter_size);
-        // Remove escaping
-        for(size_t c = 0; c < parameter.size() - 1; ++c) {
-          if(parameter[c] == '\\')
-            parameter.replace(c, 2, std::string() + parameter[c + 1]);
-        }
-        parameters.emplace_back(parameter);
-      };
-      for(size_t c = 0; c < parameters_str.size(); ++c) {
-        if(backslash)
-          backslash = false;
-        else if(parameters_str[c] == '\\')
-          backslash = true;
-        else if((parameters_str[c] == ' ' || parameters_str[c] == '\t') && !backslash && !single_quote && !double_quote) {
-          if(parameter_start_pos != std::string::npos) {
-            add_parameter();
-            parameter_start_pos = std::string::npos;
-            parameter_size = 0;
+    std::string text;
+    {
+      std::ifstream stream((build_path / "compile_commands.json").string(), std::ifstream::binary);
+      if(!stream)
+        return;
+      stream.seekg(0, std::ios::end);
+      text.resize(stream.tellg());
+      stream.seekg(0, std::ios::beg);
+      stream.read(&text[0], text.size());
+    }
+
+    JSONReader reader(text);
+    reader.expect('[');
+    if(reader.consume(']'))
+      return;
+    std::string key, directory, command, file;
+    std::vector<std::string> arguments;
+    do {
+      directory.clear();
+      command.clear();
+      file.clear();
+      arguments.clear();
+      bool has_command = false;
+      reader.expect('{');
+      if(!reader.consume('}')) {
+        do {
+          reader.read_string(key);
+          reader.expect(':');
+          if(key == "directory")
+            reader.read_string(directory);
+          else if(key == "command") {
+            reader.read_string(command);
+            has_command = true;
           }
-          continue;
+          else if(key == "arguments") {
+            reader.expect('[');
+            if(!reader.consume(']')) {
+              do {
+                arguments.emplace_back();
+                reader.read_string(arguments.back());
+              } while(reader.consume(','));
+              reader.expect(']');
+            }
+            has_command = true;
+          }
+          else if(key == "file")
+            reader.read_string(file);
+          else
+            reader.skip_value();
+        } while(reader.consume(','));
+        reader.expect('}');
+      }
+      if(directory.empty() || file.empty() || !has_command)
+        throw std::runtime_error("missing compile command field");
+
+      commands.emplace_back(Command{directory, !command.empty() ? parse_command(command) : std::move(arguments), boost::filesystem::absolute(file, build_path)});
+      file_commands[filesystem::get_normal_path(commands.back().file).string()].emplace_back(commands.size() - 1);
+    } while(reader.consume(','));
+    reader.expect(']');
+  }
+  catch(...) {
+  }
+}
+
+CompileCommands::Database::~Database() {
+  header_commands_stop = true;
+  if(header_commands_thread.joinable())
+    header_commands_thread.join();
+}
+
+const CompileCommands::Command *CompileCommands::Database::get_header_command(const boost::filesystem::path &header_path) {
+  std::unique_lock<std::mutex> lock(header_commands_mutex);
+  if(!header_commands_ready) {
+    if(!header_commands_thread.joinable() && !commands.empty())
+      header_commands_thread = std::thread([this] {
+        build_header_commands();
+      });
+    return nullptr;
+  }
+  auto it = header_commands.find(filesystem::get_normal_path(header_path).string());
+  if(it != header_commands.end())
+    return &commands[it->second.first];
+  return nullptr;
+}
+
+std::shared_ptr<void> CompileCommands::Database::add_header_commands_listener(std::function<void()> on_ready) {
+  std::unique_lock<std::mutex> lock(header_commands_mutex);
+  if(header_commands_ready || commands.empty())
+    return nullptr;
+  auto id = ++header_commands_listener_id;
+  header_commands_listeners.emplace(id, std::move(on_ready));
+  return std::shared_ptr<void>(nullptr, [database = shared_from_this(), id](void *) {
+    std::unique_lock<std::mutex> lock(database->header_commands_mutex);
+    database->header_commands_listeners.erase(id);
+  });
+}
+
+void CompileCommands::Database::build_header_commands() {
+  std::unordered_map<std::string, std::pair<size_t, size_t>> header_commands;
+  // Include directives of the scanned files, as (include, is quoted include) pairs
+  std::unordered_map<std::string, std::vector<std::pair<std::string, bool>>> file_includes;
+
+  auto get_includes = [&file_includes](const boost::filesystem::path &path) -> const std::vector<std::pair<std::string, bool>> & {
+    auto it = file_includes.find(path.string());
+    if(it != file_includes.end())
+      return it->second;
+    auto &includes = file_includes[path.string()];
+    std::ifstream stream(path.string(), std::ifstream::binary);
+    std::string line;
+    while(std::getline(stream, line)) {
+      size_t pos = 0;
+      auto skip_spaces = [&line, &pos] {
+        while(pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+          ++pos;
+      };
+      skip_spaces();
+      if(pos >= line.size() || line[pos] != '#')
+        continue;
+      ++pos;
+      skip_spaces();
+      if(line.compare(pos, 7, "include") != 0)
+        continue;
+      pos += 7;
+      skip_spaces();
+      if(pos >= line.size() || (line[pos] != '"' && line[pos] != '<'))
+        continue;
+      auto quoted = line[pos] == '"';
+      auto end_pos = line.find(quoted ? '"' : '>', pos + 1);
+      if(end_pos != std::string::npos)
+        includes.emplace_back(line.substr(pos + 1, end_pos - pos - 1), quoted);
+    }
+    return includes;
+  };
+
+  for(size_t command_index = 0; command_index < commands.size() && !header_commands_stop; ++command_index) {
+    auto &command = commands[command_index];
+    auto source_path = filesystem::get_normal_path(command.file);
+    if(!is_source(source_path))
+      continue;
+
+    auto directory = boost::filesystem::absolute(command.directory, build_path);
+    std::vector<boost::filesystem::path> include_paths;
+    for(size_t c = 0; c < command.parameters.size(); ++c) {
+      auto &parameter = command.parameters[c];
+      for(auto &flag : {"-I", "-iquote", "-isystem"}) {
+        auto flag_size = std::char_traits<char>::length(flag);
+        if(parameter.compare(0, flag_size, flag) == 0) {
+          boost::filesystem::path include_path;
+          if(parameter.size() > flag_size)
+            include_path = parameter.substr(flag_size);
+          else if(c + 1 < command.parameters.size())
+            include_path = command.parameters[c + 1];
+          if(!include_path.empty())
+            include_paths.emplace_back(filesystem::get_normal_path(boost::filesystem::absolute(include_path, directory)));
+          break;
         }
-        else if(parameters_str[c] == '\'' && !backslash && !double_quote) {
-          single_quote = !single_quote;
-          continue;
+      }
+    }
+
+    std::vector<std::pair<boost::filesystem::path, size_t>> paths_and_depths = {{source_path, 0}};
+    while(!paths_and_depths.empty()) {
+      auto path = std::move(paths_and_depths.back().first);
+      auto depth = paths_and_depths.back().second;
+      paths_and_depths.pop_back();
+      for(auto &include : get_includes(path)) {
+        boost::filesystem::path header_path;
+        boost::system::error_code ec;
+        if(include.second && boost::filesystem::is_regular_file(path.parent_path() / include.first, ec))
+          header_path = filesystem::get_normal_path(path.parent_path() / include.first);
+        else {
+          for(auto &include_path : include_paths) {
+            if(boost::filesystem::is_regular_file(include_path / include.first, ec)) {
+              header_path = filesystem::get_normal_path(include_path / include.first);
+              break;
+            }
+          }
         }
-        else if(parameters_str[c] == '\"' && !backslash && !single_quote) {
-          double_quote = !double_quote;
+        if(header_path.empty())
           continue;
-        }
 
-        if(parameter_start_pos == std::string::npos)
-          parameter_start_pos = c;
-        ++parameter_size;
+        auto it = header_commands.find(header_path.string());
+        if(it == header_commands.end()) {
+          header_commands.emplace(header_path.string(), std::make_pair(command_index, depth + 1));
+          // Includes of a header are only scanned the first time the header is found
+          paths_and_depths.emplace_back(std::move(header_path), depth + 1);
+        }
+        else if(depth + 1 < it->second.second) // Prefer source files that include the header directly
+          it->second = std::make_pair(command_index, depth + 1);
       }
-      if(parameter_start_pos != std::string::npos)
-        add_parameter();
-
-      commands.emplace_back(Command{directory, parameters, boost::filesystem::absolute(file, build_path)});
     }
   }
-  catch(...) {
+
+  std::unique_lock<std::mutex> lock(header_commands_mutex);
+  this->header_commands = std::move(header_commands);
+  header_commands_ready = true;
+  for(auto &listener : header_commands_listeners)
+    listener.second();
+  header_commands_listeners.clear();
+}
+
+CompileCommands::CompileCommands(const boost::filesystem::path &build_path) : database(get_database(build_path)), commands(database->commands) {}
+
+std::vector<const CompileCommands::Command *> CompileCommands::get_commands(const boost::filesystem::path &file_path) const {
+  std::vector<const Command *> result;
+  auto it = database->file_commands.find(filesystem::get_normal_path(file_path).string());
+  if(it != database->file_commands.end()) {
+    for(auto index : it->second)
+      result.emplace_back(&database->commands[index]);
   }
+  return result;
+}
+
+std::shared_ptr<CompileCommands::Database> CompileCommands::get_database(const boost::filesystem::path &build_path) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::shared_ptr<Database>> databases;
+
+  boost::system::error_code ec;
+  auto last_write_time = boost::filesystem::last_write_time(build_path / "compile_commands.json", ec);
+  if(ec)
+    last_write_time = 0;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  auto &database = databases[build_path.string()];
+  if(!database || database->last_write_time != last_write_time)
+    database = std::make_shared<Database>(build_path, last_write_time);
+  return database;
+}
+
+std::shared_ptr<void> CompileCommands::add_header_commands_listener(const boost::filesystem::path &build_path, std::function<void()> on_ready) {
+  if(build_path.empty())
+    return nullptr;
+  return get_database(build_path)->add_header_commands_listener(std::move(on_ready));
+}
+
+std::vector<std::string> CompileCommands::parse_command(const std::string &parameters_str) {
+  std::vector<std::string> parameters;
+  bool backslash = false;
+  bool single_quote = false;
+  bool double_quote = false;
+  size_t parameter_start_pos = std::string::npos;
+  size_t parameter_size = 0;
+  auto add_parameter = [&parameters, &parameters_str, &parameter_start_pos, &parameter_size] {
+    auto parameter = parameters_str.substr(parameter_start_pos, parameter_size);
+    // Remove escaping
+    for(size_t c = 0; c < parameter.size() - 1; ++c) {
+      if(parameter[c] == '\\')
+        parameter.replace(c, 2, std::string() + parameter[c + 1]);
+    }
+    parameters.emplace_back(parameter);
+  };
+  for(size_t c = 0; c < parameters_str.size(); ++c) {
+    if(backslash)
+      backslash = false;
+    else if(parameters_str[c] == '\\')
+      backslash = true;
+    else if((parameters_str[c] == ' ' || parameters_str[c] == '\t') && !backslash && !single_quote && !double_quote) {
+      if(parameter_start_pos != std::string::npos) {
+        add_parameter();
+        parameter_start_pos = std::string::npos;
+        parameter_size = 0;
+      }
+      continue;
+    }
+    else if(parameters_str[c] == '\'' && !backslash && !double_quote) {
+      single_quote = !single_quote;
+      continue;
+    }
+    else if(parameters_str[c] == '\"' && !backslash && !single_quote) {
+      double_quote = !double_quote;
+      continue;
+    }
+
+    if(parameter_start_pos == std::string::npos)
+      parameter_start_pos = c;
+    ++parameter_size;
+  }
+  if(parameter_start_pos != std::string::npos)
+    add_parameter();
+
+  return parameters;
 }
 
 std::vector<std::string> CompileCommands::get_arguments(const boost::filesystem::path &build_path, const boost::filesystem::path &file_path) {
+  std::shared_ptr<Database> database;
+  if(!build_path.empty()) {
+    database = get_database(build_path);
+    std::unique_lock<std::mutex> lock(database->arguments_mutex);
+    auto it = database->arguments.find(file_path.string());
+    if(it != database->arguments.end())
+      return it->second;
+  }
+
   std::string default_std_argument = "-std=c++1y";
 
   auto extension = file_path.extension().string();
   bool is_header = CompileCommands::is_header(file_path) || extension.empty(); // Include std C++ headers that are without extensions
 
   std::vector<std::string> arguments;
-  if(!build_path.empty()) {
-    clangmm::CompilationDatabase db(build_path.string());
-    if(db) {
-      clangmm::CompileCommands commands(file_path.string(), db);
-      auto cmds = commands.get_commands();
-      for(auto &cmd : cmds) {
-        auto cmd_arguments = cmd.get_arguments();
-        bool ignore_next = false;
-        for(size_t c = 1; c < cmd_arguments.size(); c++) {
-          if(ignore_next) {
-            ignore_next = false;
-            continue;
-          }
-          else if(cmd_arguments[c] == "-o" || cmd_arguments[c] == "-c" ||
-                  cmd_arguments[c] == "-x" ||                          // Remove language arguments since some tools add languages not understood by clang
-                  (is_header && cmd_arguments[c] == "-include-pch") || // Header files should not use precompiled headers
-                  cmd_arguments[c] == "-MF") {                         // Exclude dependency file generation
-            ignore_next = true;
-            continue;
-          }
-          arguments.emplace_back(cmd_arguments[c]);
+  bool memoize = true;
+  bool c_header = false;
+  if(database && !database->commands.empty()) {
+    std::vector<const Command *> commands;
+    auto it = database->file_commands.find(filesystem::get_normal_path(file_path).string());
+    if(it != database->file_commands.end()) {
+      for(auto index : it->second)
+        commands.emplace_back(&database->commands[index]);
+    }
+    else if(is_header) {
+      // Use the arguments of a source file that includes the header
+      if(auto command = database->get_header_command(file_path)) {
+        commands.emplace_back(command);
+        c_header = command->file.extension() == ".c";
+      }
+      else
+        memoize = false; // Header might be found when the include index has been built
+    }
+    for(auto &command : commands) {
+      auto &cmd_arguments = command->parameters;
+      bool ignore_next = false;
+      for(size_t c = 1; c < cmd_arguments.size(); c++) {
+        if(ignore_next) {
+          ignore_next = false;
+          continue;
         }
+        else if(cmd_arguments[c] == "-o" || cmd_arguments[c] == "-c" ||
+                cmd_arguments[c] == "-x" ||                          // Remove language arguments since some tools add languages not understood by clang
+                (is_header && cmd_arguments[c] == "-include-pch") || // Header files should not use precompiled headers
+                cmd_arguments[c] == "-MF") {                         // Exclude dependency file generation
+          ignore_next = true;
+          continue;
+        }
+        arguments.emplace_back(cmd_arguments[c]);
       }
     }
-    else
-      arguments.emplace_back(default_std_argument);
   }
   else
     arguments.emplace_back(default_std_argument);
@@ -162,6 +405,8 @@ std::vector<std::string> CompileCommands::get_arguments(const boost::filesystem:
     arguments.emplace_back("-finclude-default-header");
     arguments.emplace_back("-Wno-gcc-compat");
   }
+  else if(c_header)
+    arguments.emplace_back("-xc");
   else if(is_header)
     arguments.emplace_back("-xc++");
 
@@ -170,6 +415,11 @@ std::vector<std::string> CompileCommands::get_arguments(const boost::filesystem:
     arguments.emplace_back(build_path.string());
   }
 
+  if(database && memoize) {
+    std::unique_lock<std::mutex> lock(database->arguments_mutex);
+    database->arguments.emplace(file_path.string(), arguments);
+  }
+
   return arguments;
 }
 
@@ -1,6 +1,14 @@
 #pragma once
+#include <atomic>
 #include <boost/filesystem.hpp>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 class CompileCommands {
@@ -14,12 +22,65 @@ public:
     std::vector<std::string> parameter_values(const std::string &parameter_name) const;
   };
 
+  /// Parsed compile_commands.json, shared between CompileCommands objects with the same build path.
+  /// Reloaded only when the last write time of compile_commands.json changes.
+  class Database : public std::enable_shared_from_this<Database> {
+  public:
+    Database(const boost::filesystem::path &build_path, std::time_t last_write_time);
+    ~Database();
+
+    std::time_t last_write_time;
+    std::vector<Command> commands;
+    /// Indices to commands, with normalized file path as key
+    std::unordered_map<std::string, std::vector<size_t>> file_commands;
+
+    std::mutex arguments_mutex;
+    /// Memoized results of CompileCommands::get_arguments, with file path as key
+    std::unordered_map<std::string, std::vector<std::string>> arguments;
+
+    /// Returns a command of a source file that includes the given header file, directly or indirectly.
+    /// Returns nullptr if no such command is found or if the include index is still being built in the background.
+    const Command *get_header_command(const boost::filesystem::path &header_path);
+    /// Calls on_ready from a background thread when the include index has been built. The listener is removed when the returned object is destroyed.
+    /// Returns nullptr, without calling on_ready, if the include index has already been built or if there are no commands.
+    std::shared_ptr<void> add_header_commands_listener(std::function<void()> on_ready);
+
+  private:
+    boost::filesystem::path build_path;
+
+    std::mutex header_commands_mutex;
+    bool header_commands_ready = false;
+    /// Indices to commands and include depths, with normalized header path as key
+    std::unordered_map<std::string, std::pair<size_t, size_t>> header_commands;
+    std::thread header_commands_thread;
+    std::atomic<bool> header_commands_stop = {false};
+    std::map<size_t, std::function<void()>> header_commands_listeners;
+    size_t header_commands_listener_id = 0;
+
+    void build_header_commands();
+  };
+
+private:
+  std::shared_ptr<Database> database;
+
+public:
   CompileCommands(const boost::filesystem::path &build_path);
-  std::vector<Command> commands;
+  const std::vector<Command> &commands;
+
+  /// Returns the commands of the given file, if any
+  std::vector<const Command *> get_commands(const boost::filesystem::path &file_path) const;
 
-  /// Return arguments for the given file using libclangmm
+  /// Return arguments for the given file. The resulting arguments are cached until compile_commands.json changes.
   static std::vector<std::string> get_arguments(const boost::filesystem::path &build_path, const boost::filesystem::path &file_path);
+  /// Calls on_ready from a background thread when the include index of the given build path has been built, so that headers
+  /// that got fallback arguments from get_arguments() can be parsed again. See Database::add_header_commands_listener.
+  static std::shared_ptr<void> add_header_commands_listener(const boost::filesystem::path &build_path, std::function<void()> on_ready);
 
   static bool is_header(const boost::filesystem::path &path);
   static bool is_source(const boost::filesystem::path &path);
+
+private:
+  /// Returns the cached database of the given build path, and reloads it if compile_commands.json has changed
+  static std::shared_ptr<Database> get_database(const boost::filesystem::path &build_path);
+  static std::vector<std::string> parse_command(const std::string &command);
 };
@@ -175,6 +175,8 @@ void Config::read(const boost::property_tree::ptree &cfg) {
   source.auto_reload_changed_files = source_json.get<bool>("auto_reload_changed_files");
   source.clang_format_style = source_json.get<std::string>("clang_format_style");
   source.clang_usages_threads = static_cast<unsigned>(source_json.get<int>("clang_usages_threads"));
+  source.language_server_prestart = source_json.get<bool>("language_server_prestart", true);
+  source.language_server_grace_period = source_json.get<unsigned>("language_server_grace_period", 60);
   auto pt_doc_search = cfg.get_child("documentation_searches");
   for(auto &pt_doc_search_lang : pt_doc_search) {
     source.documentation_searches[pt_doc_search_lang.first].separator = pt_doc_search_lang.second.get<std::string>("separator");
@@ -203,4 +205,5 @@ void Config::read(const boost::property_tree::ptree &cfg) {
   terminal.font = cfg.get<std::string>("terminal.font");
 
   log.language_server = cfg.get<bool>("log.language_server");
+  log.language_server_record_path = cfg.get<std::string>("log.language_server_record_path", "");
 }
@@ -91,12 +91,16 @@ public:
     std::string clang_format_style;
     unsigned clang_usages_threads;
 
+    bool language_server_prestart;
+    unsigned language_server_grace_period;
+
     std::unordered_map<std::string, DocumentationSearch> documentation_searches;
   };
 
   class Log {
   public:
     bool language_server;
+    std::string language_server_record_path;
   };
 
 private:
@@ -3,18 +3,264 @@
 #include "filesystem.h"
 #include "project_build.h"
 #include "terminal.h"
+#include <algorithm>
+#include <atomic>
 #include <climits>
+#include <fstream>
+#include <functional>
 #include <iostream>
-#include <regex>
+#include <iterator>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <thread>
 #include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  /// Options used in all ctags commands. The output is left unsorted, so that it can be used while ctags runs, and is sorted with sort_tags().
+  const std::string ctags_options = " --fields=ns --sort=no -I \"override noexcept\" -f -";
+
+  std::mutex indexes_mutex;
+  std::map<boost::filesystem::path, std::shared_ptr<Ctags::Index>> indexes;
+
+  /// Returns the file field of a tag line, that is, the text between the first and second tab
+  std::pair<const char *, const char *> get_file_field(const char *line, const char *line_end) {
+    auto file = std::find(line, line_end, '\t');
+    if(file == line_end)
+      return {line_end, line_end};
+    ++file;
+    return {file, std::find(file, line_end, '\t')};
+  }
+
+  /// Returns true if the symbol of tag line a is sorted before the symbol of tag line b, corresponding to ctags --sort=foldcase
+  bool symbol_less(const char *a, const char *a_end, const char *b, const char *b_end) {
+    for(;; ++a, ++b) {
+      auto a_chr = a == a_end || *a == '\t' ? 0 : std::toupper(static_cast<unsigned char>(*a));
+      auto b_chr = b == b_end || *b == '\t' ? 0 : std::toupper(static_cast<unsigned char>(*b));
+      if(a_chr != b_chr)
+        return a_chr < b_chr;
+      if(a_chr == 0)
+        return false;
+    }
+  }
+
+  /// Compares the symbol of a tag line with symbol, ignoring case as in symbol_less().
+  /// If prefix is true, tag line symbols starting with symbol are considered equal to symbol.
+  int compare_symbol(const char *line, const char *line_end, const std::string &symbol, bool prefix) {
+    for(auto chr = symbol.begin();; ++line, ++chr) {
+      if(prefix && chr == symbol.end())
+        return 0;
+      auto line_chr = line == line_end || *line == '\t' ? 0 : std::toupper(static_cast<unsigned char>(*line));
+      auto symbol_chr = chr == symbol.end() ? 0 : std::toupper(static_cast<unsigned char>(*chr));
+      if(line_chr != symbol_chr)
+        return line_chr < symbol_chr ? -1 : 1;
+      if(line_chr == 0)
+        return 0;
+    }
+  }
+
+  /// Returns tags without the lines of the files that are, or are within, the given paths, merged with the sorted tag lines in new_tags
+  std::string merge_tags(const char *tags, size_t size, const std::set<boost::filesystem::path> &paths, const std::string &new_tags) {
+    std::vector<std::string> path_strings;
+    for(auto &path : paths)
+      path_strings.emplace_back(path.string());
+    auto in_paths = [&path_strings](const char *file, const char *file_end) {
+      auto size = static_cast<size_t>(file_end - file);
+      return std::any_of(path_strings.begin(), path_strings.end(), [file, size](const std::string &path) {
+        return size >= path.size() && std::equal(path.begin(), path.end(), file) &&
+               (size == path.size() || file[path.size()] == '/' || file[path.size()] == boost::filesystem::path::preferred_separator);
+      });
+    };
+
+    std::string result;
+    result.reserve(size + new_tags.size());
+    auto tags_end = tags + size, new_tags_end = new_tags.data() + new_tags.size();
+    auto line = tags, new_line = new_tags.data();
+    auto line_end = std::find(line, tags_end, '\n'), new_line_end = std::find(new_line, new_tags_end, '\n');
+    while(line < tags_end || new_line < new_tags_end) {
+      if(line < tags_end) {
+        auto file = get_file_field(line, line_end);
+        if(in_paths(file.first, file.second)) {
+          line = line_end == tags_end ? tags_end : line_end + 1;
+          line_end = std::find(line, tags_end, '\n');
+          continue;
+        }
+      }
+      if(new_line < new_tags_end && (line >= tags_end || symbol_less(new_line, new_line_end, line, line_end))) {
+        result.append(new_line, new_line_end).append(1, '\n');
+        new_line = new_line_end == new_tags_end ? new_tags_end : new_line_end + 1;
+        new_line_end = std::find(new_line, new_tags_end, '\n');
+      }
+      else {
+        result.append(line, line_end).append(1, '\n');
+        line = line_end == tags_end ? tags_end : line_end + 1;
+        line_end = std::find(line, tags_end, '\n');
+      }
+    }
+    return result;
+  }
+
+  /// Returns the tag lines sorted case-insensitively on symbol. Lines with equal symbols keep their order.
+  std::string sort_tags(const std::string &tags) {
+    std::vector<std::pair<const char *, const char *>> lines;
+    for(size_t start = 0, end; start < tags.size(); start = end + 1) {
+      end = tags.find('\n', start);
+      if(end == std::string::npos)
+        end = tags.size();
+      lines.emplace_back(&tags[start], &tags[end]);
+    }
+    std::stable_sort(lines.begin(), lines.end(), [](const std::pair<const char *, const char *> &a, const std::pair<const char *, const char *> &b) {
+      return symbol_less(a.first, a.second, b.first, b.second);
+    });
+
+    std::string result;
+    result.reserve(tags.size() + 1);
+    for(auto &line : lines)
+      result.append(line.first, line.second).append(1, '\n');
+    return result;
+  }
+
+  /// Returns the merged tag lines of tags that are each sorted with sort_tags()
+  std::string merge_sorted_tags(const std::vector<std::string> &sorted_tags) {
+    class Line {
+    public:
+      const char *begin, *end, *tags_end;
+    };
+    auto greater = [](const Line &a, const Line &b) {
+      return symbol_less(b.begin, b.end, a.begin, a.end);
+    };
+    std::priority_queue<Line, std::vector<Line>, decltype(greater)> lines(greater);
+    size_t size = 0;
+    for(auto &tags : sorted_tags) {
+      if(!tags.empty()) {
+        auto tags_end = tags.data() + tags.size();
+        lines.push({tags.data(), std::find(tags.data(), tags_end, '\n'), tags_end});
+        size += tags.size();
+      }
+    }
+
+    std::string result;
+    result.reserve(size);
+    while(!lines.empty()) {
+      auto line = lines.top();
+      lines.pop();
+      result.append(line.begin, line.end).append(1, '\n');
+      if(line.end != line.tags_end && line.end + 1 != line.tags_end)
+        lines.push({line.end + 1, std::find(line.end + 1, line.tags_end, '\n'), line.tags_end});
+    }
+    return result;
+  }
+
+  /// Stream buffer that passes the written bytes to a function, used to process ctags output while ctags runs
+  class FunctionStreamBuffer : public std::streambuf {
+    std::function<void(const char *bytes, size_t n)> function;
+
+  public:
+    FunctionStreamBuffer(std::function<void(const char *bytes, size_t n)> function_) : function(std::move(function_)) {}
+
+  protected:
+    std::streamsize xsputn(const char *bytes, std::streamsize n) override {
+      function(bytes, n);
+      return n;
+    }
+    int_type overflow(int_type ch) override {
+      if(ch != traits_type::eof()) {
+        auto chr = traits_type::to_char_type(ch);
+        function(&chr, 1);
+      }
+      return ch;
+    }
+  };
+} // namespace
 
-std::pair<boost::filesystem::path, std::unique_ptr<std::stringstream>> Ctags::get_result(const boost::filesystem::path &path) {
+Ctags::Tags::Tags(std::string tags) : string(std::move(tags)), tags_data(string.data()), tags_size(string.size()) {}
+
+Ctags::Tags::~Tags() {
+#ifndef _WIN32
+  if(map_address)
+    munmap(map_address, tags_size);
+#endif
+}
+
+std::shared_ptr<Ctags::Tags> Ctags::Tags::open(const boost::filesystem::path &path) {
+#ifdef _WIN32
+  std::ifstream stream(path.string(), std::ifstream::binary);
+  if(!stream)
+    return nullptr;
+  return std::make_shared<Tags>(std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()));
+#else
+  auto fd = ::open(path.string().c_str(), O_RDONLY);
+  if(fd < 0)
+    return nullptr;
+  struct stat status;
+  if(fstat(fd, &status) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  auto tags = std::shared_ptr<Tags>(new Tags());
+  if(status.st_size > 0) {
+    auto address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(address == MAP_FAILED) {
+      close(fd);
+      return nullptr;
+    }
+    tags->map_address = address;
+    tags->tags_data = static_cast<const char *>(address);
+    tags->tags_size = status.st_size;
+  }
+  close(fd);
+  return tags;
+#endif
+}
+
+std::pair<const char *, const char *> Ctags::Tags::find(const std::string &symbol, bool prefix) const {
+  auto begin = tags_data, end = tags_data + tags_size;
+  auto next_line = [end](const char *line_end) {
+    return line_end == end ? end : line_end + 1;
+  };
+
+  // Lower bound, where low is always at the start of a line
+  auto low = begin, high = end;
+  while(low < high) {
+    auto middle = low + (high - low) / 2;
+    auto line = middle;
+    while(line > low && *(line - 1) != '\n')
+      --line;
+    auto line_end = std::find(middle, end, '\n');
+    if(compare_symbol(line, line_end, symbol, prefix) < 0)
+      low = next_line(line_end);
+    else
+      high = line;
+  }
+
+  auto last = low;
+  while(last < end) {
+    auto line_end = std::find(last, end, '\n');
+    if(compare_symbol(last, line_end, symbol, prefix) != 0)
+      break;
+    last = next_line(line_end);
+  }
+  return {low, last};
+}
+
+Ctags::Index::Index(boost::filesystem::path run_path_, std::vector<boost::filesystem::path> exclude_paths_)
+    : run_path(std::move(run_path_)), exclude_paths(std::move(exclude_paths_)) {
+  tags_path = Config::get().home_juci_path / "ctags" / (run_path.filename().string() + '-' + std::to_string(std::hash<std::string>()(run_path.string())) + ".tags");
+}
+
+std::shared_ptr<Ctags::Index> Ctags::Index::get(const boost::filesystem::path &path) {
   auto build = Project::Build::create(path);
   auto run_path = build->project_path;
-  std::string exclude = " --exclude=node_modules";
+  std::vector<boost::filesystem::path> exclude_paths = {"node_modules"};
   if(!run_path.empty()) {
-    exclude += " --exclude=" + filesystem::get_relative_path(build->get_default_path(), run_path).string();
-    exclude += " --exclude=" + filesystem::get_relative_path(build->get_debug_path(), run_path).string();
+    exclude_paths.emplace_back(filesystem::get_relative_path(build->get_default_path(), run_path));
+    exclude_paths.emplace_back(filesystem::get_relative_path(build->get_debug_path(), run_path));
   }
   else {
     boost::system::error_code ec;
@@ -24,48 +270,362 @@ std::pair<boost::filesystem::path, std::unique_ptr<std::stringstream>> Ctags::ge
       run_path = path.parent_path();
   }
 
-  std::stringstream stdin_stream;
-  //TODO: when debian stable gets newer g++ version that supports move on streams, remove unique_ptr below
-  auto stdout_stream = std::make_unique<std::stringstream>();
-  auto command = Config::get().project.ctags_command + exclude + " --fields=ns --sort=foldcase -I \"override noexcept\" -f - -R *";
-  Terminal::get().process(stdin_stream, *stdout_stream, command, run_path);
-  return {run_path, std::move(stdout_stream)};
+  std::unique_lock<std::mutex> lock(indexes_mutex);
+  auto it = indexes.find(run_path);
+  if(it != indexes.end())
+    return it->second;
+  auto index = std::shared_ptr<Index>(new Index(run_path, std::move(exclude_paths)));
+  indexes.emplace(run_path, index);
+  lock.unlock();
+
+  // Use the stored index until the index is rebuilt, since the project files might have been changed after it was stored
+  if(auto tags = Tags::open(index->tags_path)) {
+    std::unique_lock<std::mutex> lock(index->mutex);
+    if(!index->tags)
+      index->tags = std::move(tags);
+  }
+  index->condition_variable.notify_all();
+
+  std::thread build_thread([index] {
+    Index::build(index);
+  });
+  build_thread.detach();
+  return index;
+}
+
+void Ctags::Index::update(const boost::filesystem::path &path) {
+  std::vector<std::shared_ptr<Index>> path_indexes;
+  {
+    std::unique_lock<std::mutex> lock(indexes_mutex);
+    for(auto &index : indexes) {
+      if(filesystem::file_in_path(path, index.first))
+        path_indexes.emplace_back(index.second);
+    }
+  }
+
+  for(auto &index : path_indexes) {
+    auto relative_path = filesystem::get_relative_path(path, index->run_path);
+    // As in get_shards(), hidden files and directories in the project directory are not included
+    if(relative_path.empty() || relative_path.begin()->string().compare(0, 1, ".") == 0 || index->is_excluded(relative_path))
+      continue;
+
+    std::unique_lock<std::mutex> lock(index->mutex);
+    index->pending_paths.emplace(std::move(relative_path));
+    if(!index->updating) {
+      index->updating = true;
+      std::thread update_thread([index] {
+        update_pending_paths(index);
+      });
+      update_thread.detach();
+    }
+  }
+}
+
+std::shared_ptr<const Ctags::Tags> Ctags::Index::get_tags() {
+  std::unique_lock<std::mutex> lock(mutex);
+  condition_variable.wait(lock, [this] { return tags != nullptr; });
+  return tags;
+}
+
+std::shared_ptr<const Ctags::Tags> Ctags::Index::try_get_tags() {
+  std::unique_lock<std::mutex> lock(mutex);
+  return tags;
+}
+
+std::shared_ptr<void> Ctags::Index::add_tags_listener(std::function<void(std::shared_ptr<const std::string> tags)> on_tags) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if(tags)
+    return nullptr;
+  if(!partial_tags.empty())
+    on_tags(std::make_shared<std::string>(partial_tags));
+  auto id = ++tags_listener_id;
+  tags_listeners.emplace(id, std::move(on_tags));
+  return std::shared_ptr<void>(nullptr, [index = shared_from_this(), id](void *) {
+    std::unique_lock<std::mutex> lock(index->mutex);
+    index->tags_listeners.erase(id);
+  });
+}
+
+bool Ctags::Index::is_excluded(const boost::filesystem::path &relative_path) const {
+  return std::any_of(exclude_paths.begin(), exclude_paths.end(), [&relative_path](const boost::filesystem::path &exclude_path) {
+    if(exclude_path.empty())
+      return false;
+    if(std::next(exclude_path.begin()) == exclude_path.end()) // As in ctags, a file name excludes all files and directories with that name
+      return std::find(relative_path.begin(), relative_path.end(), exclude_path) != relative_path.end();
+    return filesystem::file_in_path(relative_path, exclude_path);
+  });
+}
+
+std::string Ctags::Index::get_command() const {
+  std::string exclude;
+  for(auto &exclude_path : exclude_paths) {
+    if(!exclude_path.empty())
+      exclude += " --exclude=" + exclude_path.string();
+  }
+  return Config::get().project.ctags_command + exclude + ctags_options + " -R";
+}
+
+std::vector<std::vector<boost::filesystem::path>> Ctags::Index::get_shards() const {
+  // Each directory below the top level directories is a shard, and the files of each directory above are shards as well.
+  // Directories with many files are split into several shards, so that they are tagged in parallel.
+  const size_t max_shard_files = 100;
+  std::vector<std::vector<boost::filesystem::path>> shards;
+  auto add_files_shards = [&shards, max_shard_files](std::vector<boost::filesystem::path> &&files) {
+    for(size_t start = 0; start < files.size(); start += max_shard_files) {
+      auto end = std::min(start + max_shard_files, files.size());
+      shards.emplace_back(std::make_move_iterator(files.begin() + start), std::make_move_iterator(files.begin() + end));
+    }
+  };
+  std::vector<boost::filesystem::path> files;
+  boost::system::error_code ec;
+  boost::filesystem::directory_iterator end_it;
+  for(boost::filesystem::directory_iterator it(run_path, ec); it != end_it; it.increment(ec)) {
+    auto name = it->path().filename();
+    if(name.string().compare(0, 1, ".") == 0 || is_excluded(name)) // As with ctags -R *, hidden files are not included
+      continue;
+    if(!boost::filesystem::is_directory(it->path(), ec)) {
+      files.emplace_back(std::move(name));
+      continue;
+    }
+    std::vector<boost::filesystem::path> directory_files;
+    for(boost::filesystem::directory_iterator directory_it(it->path(), ec); directory_it != end_it; directory_it.increment(ec)) {
+      auto relative_path = name / directory_it->path().filename();
+      if(is_excluded(relative_path))
+        continue;
+      if(boost::filesystem::is_directory(directory_it->path(), ec))
+        shards.emplace_back(std::vector<boost::filesystem::path>{std::move(relative_path)});
+      else
+        directory_files.emplace_back(std::move(relative_path));
+    }
+    add_files_shards(std::move(directory_files));
+  }
+  add_files_shards(std::move(files));
+  return shards;
+}
+
+void Ctags::Index::build(std::shared_ptr<Index> index) {
+  auto command = index->get_command() + " -L -";
+
+  auto shards = index->get_shards();
+  std::vector<std::string> shard_tags(shards.size());
+  std::atomic<size_t> next_shard(0);
+  auto run_shards = [&] {
+    for(size_t shard; (shard = next_shard++) < shards.size();) {
+      auto &tags = shard_tags[shard];
+      size_t tags_size = 0; // Size of the complete tag lines in tags
+      FunctionStreamBuffer stdout_buffer([&index, &tags, &tags_size](const char *bytes, size_t n) {
+        tags.append(bytes, n);
+        auto end = tags.rfind('\n');
+        if(end == std::string::npos || end + 1 <= tags_size)
+          return;
+        std::unique_lock<std::mutex> lock(index->mutex);
+        index->partial_tags.append(tags, tags_size, end + 1 - tags_size);
+        if(!index->tags_listeners.empty()) {
+          auto new_tags = std::make_shared<std::string>(tags, tags_size, end + 1 - tags_size);
+          for(auto &tags_listener : index->tags_listeners)
+            tags_listener.second(new_tags);
+        }
+        tags_size = end + 1;
+      });
+      std::stringstream stdin_stream;
+      for(auto &path : shards[shard])
+        stdin_stream << path.string() << '\n';
+      std::ostream stdout_stream(&stdout_buffer);
+      Terminal::get().process(stdin_stream, stdout_stream, command, index->run_path);
+      tags.resize(tags_size);
+      tags = sort_tags(tags);
+    }
+  };
+  std::vector<std::thread> threads;
+  auto thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), shards.size());
+  for(size_t c = 1; c < thread_count; ++c)
+    threads.emplace_back(run_shards);
+  run_shards();
+  for(auto &thread : threads)
+    thread.join();
+
+  std::shared_ptr<const Tags> tags = std::make_shared<Tags>(merge_sorted_tags(shard_tags));
+
+  {
+    std::unique_lock<std::mutex> lock(index->mutex);
+    index->tags = tags;
+    index->building = false;
+    index->partial_tags.clear();
+    index->partial_tags.shrink_to_fit();
+    index->tags_listeners.clear();
+  }
+  index->condition_variable.notify_all();
+  index->save(std::move(tags));
+}
+
+void Ctags::Index::update_pending_paths(std::shared_ptr<Index> index) {
+  std::unique_lock<std::mutex> lock(index->mutex);
+  // Files changed during a build might not be reflected in the built tags
+  index->condition_variable.wait(lock, [&index] { return !index->building; });
+  while(!index->pending_paths.empty()) {
+    auto paths = std::move(index->pending_paths);
+    index->pending_paths.clear();
+    lock.unlock();
+
+    // Paths that no longer exist are only removed from the tags, and directories are tagged recursively
+    std::string arguments;
+    for(auto &path : paths) {
+      boost::system::error_code ec;
+      if(boost::filesystem::exists(index->run_path / path, ec))
+        arguments += ' ' + filesystem::escape_argument(path.string());
+    }
+    std::stringstream stdin_stream, stdout_stream, stderr_stream;
+    if(!arguments.empty())
+      Terminal::get().process(stdin_stream, stdout_stream, index->get_command() + arguments, index->run_path, &stderr_stream);
+
+    lock.lock();
+    auto tags = index->tags;
+    lock.unlock();
+    tags = std::make_shared<Tags>(merge_tags(tags->data(), tags->size(), paths, sort_tags(stdout_stream.str())));
+    lock.lock();
+    index->tags = tags;
+    lock.unlock();
+    index->save(std::move(tags));
+    lock.lock();
+  }
+  index->updating = false;
+}
+
+void Ctags::Index::save(std::shared_ptr<const Tags> tags) {
+  std::unique_lock<std::mutex> save_lock(save_mutex);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if(this->tags != tags)
+      return;
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(tags_path.parent_path(), ec);
+  auto tmp_path = tags_path;
+  tmp_path += ".tmp";
+  {
+    std::ofstream stream(tmp_path.string(), std::ofstream::binary);
+    if(!stream)
+      return;
+    stream.write(tags->data(), tags->size());
+    if(!stream)
+      return;
+  }
+  boost::filesystem::rename(tmp_path, tags_path, ec);
+  if(ec)
+    return;
+
+#ifndef _WIN32
+  // Release the memory held by tags, since the stored file is mapped on demand by the operating system
+  if(auto stored_tags = Tags::open(tags_path)) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if(this->tags == tags)
+      this->tags = std::move(stored_tags);
+  }
+#endif
+}
+
+std::pair<boost::filesystem::path, std::shared_ptr<const Ctags::Tags>> Ctags::get_result(const boost::filesystem::path &path) {
+  auto index = Index::get(path);
+  return {index->run_path, index->get_tags()};
 }
 
 Ctags::Location Ctags::get_location(const std::string &line, bool markup) {
+  return get_location(line.data(), line.size(), markup);
+}
+
+Ctags::Location Ctags::get_location(const char *line, size_t size, bool markup) {
   Location location;
 
+  auto end = line + size;
 #ifdef _WIN32
-  auto line_fixed = line;
-  if(!line_fixed.empty() && line_fixed.back() == '\r')
-    line_fixed.pop_back();
-#else
-  auto &line_fixed = line;
+  if(end != line && *(end - 1) == '\r')
+    --end;
 #endif
 
-  const static std::regex regex(R"(^([^\t]+)\t([^\t]+)\t(?:/\^)?([ \t]*)(.+?)(\$/)?;"\tline:([0-9]+)\t?[a-zA-Z]*:?(.*)$)");
-  std::smatch sm;
-  if(std::regex_match(line_fixed, sm, regex)) {
-    location.symbol = sm[1].str();
-    //fix location.symbol for operators
-    if(9 < location.symbol.size() && location.symbol[8] == ' ' && location.symbol.compare(0, 8, "operator") == 0) {
-      auto &chr = location.symbol[9];
-      if(!((chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || (chr >= '0' && chr <= '9') || chr == '_'))
-        location.symbol.erase(8, 1);
+  // Parses lines on the form: symbol\tfile\t/^[whitespace]source$/;"\tline:number[\tkind:scope], where the source can also be given without /^ and $/
+  auto parse = [&location, line, end]() {
+    auto symbol_end = std::find(line, end, '\t');
+    if(symbol_end == line || symbol_end == end)
+      return false;
+    auto file = symbol_end + 1;
+    auto file_end = std::find(file, end, '\t');
+    if(file_end == file || file_end == end)
+      return false;
+
+    // Returns the position of the first ;"\tline:[0-9] at or after from
+    static const char marker[] = ";\"\tline:";
+    const size_t marker_size = sizeof(marker) - 1;
+    auto find_marker = [end](const char *from) {
+      for(; from < end; ++from) {
+        from = std::search(from, end, marker, marker + marker_size);
+        if(from == end || (from + marker_size < end && from[marker_size] >= '0' && from[marker_size] <= '9'))
+          return from;
+      }
+      return end;
+    };
+
+    const char *pattern_start = file_end + 1, *whitespace_start = end, *source_start = end, *marker_start = end;
+    bool pattern = pattern_start + 2 <= end && pattern_start[0] == '/' && pattern_start[1] == '^';
+    for(auto start : {pattern ? pattern_start + 2 : end, pattern_start}) {
+      if(start == end)
+        continue;
+      whitespace_start = start;
+      source_start = start;
+      while(source_start < end && (*source_start == ' ' || *source_start == '\t'))
+        ++source_start;
+      if(source_start < end && (marker_start = find_marker(source_start + 1)) != end)
+        break;
+      // The source must be non-empty, and can therefore start within the leading whitespace
+      if(source_start != start && (marker_start = find_marker(start + 1)) != end) {
+        source_start = marker_start - 1;
+        break;
+      }
     }
+    if(marker_start == end)
+      return false;
+
+    auto source_end = marker_start;
+    bool pattern_end = marker_start - source_start >= 3 && *(marker_start - 2) == '$' && *(marker_start - 1) == '/';
+    if(pattern_end)
+      source_end -= 2;
 
-    location.file_path = sm[2].str();
-    location.source = sm[4].str();
+    auto line_number = marker_start + marker_size;
+    auto line_number_end = line_number;
+    while(line_number_end < end && *line_number_end >= '0' && *line_number_end <= '9')
+      ++line_number_end;
+
+    auto scope = line_number_end;
+    if(scope < end && *scope == '\t')
+      ++scope;
+    while(scope < end && ((*scope >= 'a' && *scope <= 'z') || (*scope >= 'A' && *scope <= 'Z')))
+      ++scope;
+    if(scope < end && *scope == ':')
+      ++scope;
+
+    location.symbol.assign(line, symbol_end);
+    location.file_path = std::string(file, file_end);
+    location.source.assign(source_start, source_end);
     try {
-      location.line = std::stoul(sm[6]) - 1;
+      location.line = std::stoul(std::string(line_number, line_number_end)) - 1;
     }
     catch(const std::exception &) {
       location.line = 0;
     }
-    location.scope = sm[7].str();
-    if(!sm[5].str().empty()) {
-      location.index = sm[3].str().size();
+    location.scope.assign(scope, end);
+    location.index = pattern_end ? source_start - whitespace_start : static_cast<size_t>(-1);
+    return true;
+  };
 
+  if(parse()) {
+    //fix location.symbol for operators
+    if(9 < location.symbol.size() && location.symbol[8] == ' ' && location.symbol.compare(0, 8, "operator") == 0) {
+      auto &chr = location.symbol[9];
+      if(!((chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || (chr >= '0' && chr <= '9') || chr == '_'))
+        location.symbol.erase(8, 1);
+    }
+
+    if(location.index != static_cast<size_t>(-1)) {
       size_t pos = location.source.find(location.symbol);
       if(pos != std::string::npos)
         location.index += pos;
@@ -89,7 +649,7 @@ Ctags::Location Ctags::get_location(const std::string &line, bool markup) {
     }
   }
   else
-    std::cerr << "Warning (ctags): please report to the juCi++ project that the following line was not parsed:\n" << line << std::endl;
+    std::cerr << "Warning (ctags): please report to the juCi++ project that the following line was not parsed:\n" << std::string(line, size) << std::endl;
 
   return location;
 }
@@ -118,10 +678,9 @@ std::vector<std::string> Ctags::get_type_parts(const std::string &type) {
 
 std::vector<Ctags::Location> Ctags::get_locations(const boost::filesystem::path &path, const std::string &name, const std::string &type) {
   auto result = get_result(path);
-  result.second->seekg(0, std::ios::end);
-  if(result.second->tellg() == 0)
+  auto &tags = *result.second;
+  if(tags.empty())
     return std::vector<Location>();
-  result.second->seekg(0, std::ios::beg);
 
   //insert name into type
   size_t c = 0;
@@ -139,13 +698,31 @@ std::vector<Ctags::Location> Ctags::get_locations(const boost::filesystem::path
 
   auto parts = get_type_parts(full_type);
 
-  std::string line;
+  // Only the tag lines of the symbol, that is name without scope, are parsed
+  auto symbol = name;
+  auto pos = symbol.rfind("::");
+  if(pos != std::string::npos)
+    symbol.erase(0, pos + 2);
+  bool prefix = false;
+  if(symbol.size() > 8 && symbol.compare(0, 8, "operator") == 0) {
+    auto &chr = symbol[8];
+    if(!((chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || (chr >= '0' && chr <= '9') || chr == '_')) {
+      // Operator symbols in tag lines can contain spaces, for instance operator <
+      symbol.erase(8);
+      prefix = true;
+    }
+  }
+  auto range = tags.find(symbol, prefix);
+
   long best_score = LONG_MIN;
   std::vector<Location> best_locations;
-  while(std::getline(*result.second, line)) {
-    if(line.size() > 2048)
+  for(auto line = range.first; line < range.second;) {
+    auto line_end = std::find(line, range.second, '\n');
+    auto size = static_cast<size_t>(line_end - line);
+    line = line_end == range.second ? range.second : line_end + 1;
+    if(size > 2048)
       continue;
-    auto location = Ctags::get_location(line, false);
+    auto location = Ctags::get_location(line_end - size, size, false);
     if(!location.scope.empty()) {
       if(location.scope + "::" + location.symbol != name)
         continue;
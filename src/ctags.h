@@ -1,6 +1,11 @@
 #pragma once
 #include <boost/filesystem.hpp>
-#include <sstream>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -17,9 +22,95 @@ public:
     operator bool() const { return !file_path.empty(); }
   };
 
-  static std::pair<boost::filesystem::path, std::unique_ptr<std::stringstream>> get_result(const boost::filesystem::path &path);
+  /// Tag lines sorted case-insensitively on symbol, either held in memory or mapped from a stored tags file
+  class Tags {
+    Tags() = default;
+
+  public:
+    Tags(std::string tags);
+    Tags(const Tags &) = delete;
+    Tags &operator=(const Tags &) = delete;
+    ~Tags();
+
+    /// Maps the tags file at path into memory. Returns nullptr if the file could not be opened.
+    static std::shared_ptr<Tags> open(const boost::filesystem::path &path);
+
+    const char *data() const { return tags_data; }
+    size_t size() const { return tags_size; }
+    bool empty() const { return tags_size == 0; }
+
+    /// Returns the range of tag lines whose symbol equals symbol, ignoring case, through binary search.
+    /// If prefix is true, the range of tag lines whose symbol starts with symbol is returned instead.
+    std::pair<const char *, const char *> find(const std::string &symbol, bool prefix = false) const;
+
+  private:
+    std::string string;
+    const char *tags_data = nullptr;
+    size_t tags_size = 0;
+    void *map_address = nullptr;
+  };
+
+  /// Tag database of a project, stored in ~/.juci/ctags. The index is built in the background,
+  /// and the tags of single files or directories are updated through update().
+  class Index : public std::enable_shared_from_this<Index> {
+    Index(boost::filesystem::path run_path, std::vector<boost::filesystem::path> exclude_paths);
+
+  public:
+    /// Returns the index of the project containing path, and starts building the index if needed
+    static std::shared_ptr<Index> get(const boost::filesystem::path &path);
+    /// Updates the tags of the given file or directory, for instance after a file is saved, in the indexes containing the path.
+    /// The tags of a path that no longer exists are removed.
+    static void update(const boost::filesystem::path &path);
+
+    const boost::filesystem::path run_path;
+
+    /// Returns the tags of the project. Waits for the first build of the index if needed.
+    std::shared_ptr<const Tags> get_tags();
+    /// Returns the tags of the project, or nullptr if the index is being built and no stored index was found
+    std::shared_ptr<const Tags> try_get_tags();
+    /// While the index is being built, calls on_tags from the building thread with the tag lines found so far, and thereafter
+    /// with new tag lines as they are found. These tag lines are not sorted. The listener is removed when the returned object is destroyed.
+    /// Returns nullptr, without calling on_tags, if the tags are already available through try_get_tags().
+    std::shared_ptr<void> add_tags_listener(std::function<void(std::shared_ptr<const std::string> tags)> on_tags);
+
+  private:
+    /// Relative to run_path
+    const std::vector<boost::filesystem::path> exclude_paths;
+    boost::filesystem::path tags_path;
+
+    std::mutex mutex;
+    std::condition_variable condition_variable;
+    std::shared_ptr<const Tags> tags;
+    /// True until the index has been built
+    bool building = true;
+    /// Complete tag lines found by the ctags processes while the index is being built
+    std::string partial_tags;
+    std::map<size_t, std::function<void(std::shared_ptr<const std::string> tags)>> tags_listeners;
+    size_t tags_listener_id = 0;
+    /// Files and directories, relative to run_path, that are waiting to be updated
+    std::set<boost::filesystem::path> pending_paths;
+    bool updating = false;
+
+    std::mutex save_mutex;
+
+    /// Returns true if the file or directory, relative to run_path, is excluded from the index
+    bool is_excluded(const boost::filesystem::path &relative_path) const;
+    /// Returns the ctags command, with the exclude options of the index, that tags the given files and directories recursively
+    std::string get_command() const;
+    /// Splits the project into paths, relative to run_path, for separate ctags processes
+    std::vector<std::vector<boost::filesystem::path>> get_shards() const;
+    static void build(std::shared_ptr<Index> index);
+    static void update_pending_paths(std::shared_ptr<Index> index);
+    /// Stores tags, unless newer tags have replaced them, and thereafter uses the stored file in place of tags held in memory
+    void save(std::shared_ptr<const Tags> tags);
+  };
+
+  /// Returns the path the tag file paths are relative to, and the tags of the project containing path
+  static std::pair<boost::filesystem::path, std::shared_ptr<const Tags>> get_result(const boost::filesystem::path &path);
 
   static Location get_location(const std::string &line, bool markup);
+  /// Parses a tag line of the given size, excluding newline
+  static Location get_location(const char *line, size_t size, bool markup);
 
   static std::vector<Location> get_locations(const boost::filesystem::path &path, const std::string &name, const std::string &type);
 
@@ -1,7 +1,10 @@
 #include "directories.h"
+#include "ctags.h"
 #include "entrybox.h"
 #include "filesystem.h"
 #include "notebook.h"
+#include "project.h"
+#include "project_files.h"
 #include "source.h"
 #include "terminal.h"
 #include <algorithm>
@@ -391,6 +394,13 @@ void Directories::open(const boost::filesystem::path &dir_path) {
   directories.clear();
 
   add_or_update_path(path, Gtk::TreeModel::Row(), true);
+
+  auto build = Project::Build::create(path);
+  if(!build->project_path.empty()) {
+    Ctags::Index::get(build->project_path); // Starts building the symbol index of the project in the background
+    ProjectFiles::get(build->project_path); // Starts listing the files of the project in the background
+    Project::prestart_language_server(*build);
+  }
 }
 
 void Directories::update() {
@@ -402,12 +412,15 @@ void Directories::update() {
 }
 
 void Directories::on_save_file(const boost::filesystem::path &file_path) {
+  // The symbol index is updated by the directory monitor if the directory of the file is monitored
   auto it = directories.find(file_path.parent_path().string());
   if(it != directories.end()) {
     if(it->second.repository)
       it->second.repository->clear_saved_status();
     colorize_path(it->first, true);
   }
+  else
+    Ctags::Index::update(file_path);
 }
 
 void Directories::select(const boost::filesystem::path &select_path) {
@@ -526,11 +539,16 @@ void Directories::add_or_update_path(const boost::filesystem::path &dir_path, co
     }
 
     monitor->signal_changed().connect([this, connection, path_and_row, repository](const Glib::RefPtr<Gio::File> &file,
-                                                                                   const Glib::RefPtr<Gio::File> &,
+                                                                                   const Glib::RefPtr<Gio::File> &other_file,
                                                                                    Gio::FileMonitorEvent monitor_event) {
       if(monitor_event != Gio::FileMonitorEvent::FILE_MONITOR_EVENT_CHANGES_DONE_HINT) {
         if(repository)
           repository->clear_saved_status();
+        if(monitor_event != Gio::FileMonitorEvent::FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
+          Ctags::Index::update(file->get_path());
+          if(other_file) // The new path of a renamed file or directory
+            Ctags::Index::update(other_file->get_path());
+        }
         connection->disconnect();
         *connection = Glib::signal_timeout().connect([path_and_row, this]() {
           if(directories.find(path_and_row->first.string()) != directories.end())
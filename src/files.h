@@ -63,7 +63,11 @@ const std::string default_config_file = R"RAW({
         "clang_format_style_comment": "IndentWidth, AccessModifierOffset and UseTab are set automatically. See http://clang.llvm.org/docs/ClangFormatStyleOptions.html",
         "clang_format_style": "ColumnLimit: 0, NamespaceIndentation: All",
         "clang_usages_threads_comment": "The number of threads used in finding usages in unparsed files. -1 corresponds to the number of cores available, and 0 disables the search",
-        "clang_usages_threads": -1
+        "clang_usages_threads": -1,
+        "language_server_prestart_comment": "Start and initialize the language server of a Rust, Python or JavaScript project in the background when the project is opened",
+        "language_server_prestart": true,
+        "language_server_grace_period_comment": "Seconds to keep a language server running after its last source file is closed. Use 0 to stop the language server immediately",
+        "language_server_grace_period": 60
     },
     "terminal": {
         "history_size": 1000,
@@ -87,6 +91,7 @@ const std::string default_config_file = R"RAW({
         "edit_copy": "<primary>c",
         "edit_paste": "<primary>v",
         "edit_find": "<primary>f",
+        "edit_find_in_files": "<primary><alt>f",
         "source_spellcheck": "",
         "source_spellcheck_clear": "",
         "source_spellcheck_next_error": "<primary><shift>e",
@@ -193,7 +198,9 @@ const std::string default_config_file = R"RAW({
         }
     },
     "log": {
-        "language_server": false
+        "language_server": false,
+        "language_server_record_path_comment": "If not empty, raw language server traffic is recorded to files in this directory. The recordings can be replayed with replay-language-server",
+        "language_server_record_path": ""
     }
 }
 )RAW";
@@ -0,0 +1,365 @@
+#include "find_in_files.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  /// Number of bytes searched for a null character to detect binary text, same as git
+  const size_t binary_check_size = 8000;
+  /// Files of at least this size are mapped to memory, while smaller files are faster to read into a buffer
+  const size_t mmap_min_size = 1024 * 1024;
+  /// Number of bytes scanned for both cases of a letter at a time
+  const size_t scan_block_size = 4096;
+  /// Maximum number of bytes that std::regex is run on at a time. std::regex recurses for each character it matches,
+  /// and could overflow the stack of a worker thread on long lines, for instance in minified files.
+  const size_t regex_max_line_size = 1000;
+
+  char ascii_tolower(char chr) {
+    return chr >= 'A' && chr <= 'Z' ? chr + ('a' - 'A') : chr;
+  }
+  char ascii_toupper(char chr) {
+    return chr >= 'a' && chr <= 'z' ? chr - ('a' - 'A') : chr;
+  }
+
+  bool is_alphanumeric(char chr) {
+    return (chr >= '0' && chr <= '9') || (chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z');
+  }
+
+  /// Returns the longest string outside of groups and character classes that every match of the ECMAScript regular expression contains,
+  /// or an empty string if there is none, for instance when the expression has an alternative outside of groups
+  std::string get_required_literal(const std::string &regex) {
+    std::string longest, current;
+    auto end_current = [&longest, &current] {
+      if(current.size() > longest.size())
+        longest = current;
+      current.clear();
+    };
+    int depth = 0;
+    for(size_t c = 0; c < regex.size(); ++c) {
+      auto chr = regex[c];
+      if(chr == '\\' && c + 1 < regex.size()) {
+        chr = regex[++c];
+        if(!is_alphanumeric(chr)) {
+          if(depth == 0)
+            current += chr;
+          continue;
+        }
+        // Character class, assertion, control character or backreference
+        if(chr == 'x')
+          c += 2;
+        else if(chr == 'u')
+          c += 4;
+        else if(chr == 'c')
+          ++c;
+        else if(chr >= '0' && chr <= '9') {
+          while(c + 1 < regex.size() && regex[c + 1] >= '0' && regex[c + 1] <= '9')
+            ++c;
+        }
+        end_current();
+      }
+      else if(chr == '[') {
+        if(c + 1 < regex.size() && regex[c + 1] == '^')
+          ++c;
+        if(c + 1 < regex.size() && regex[c + 1] == ']')
+          ++c;
+        while(c + 1 < regex.size() && regex[c + 1] != ']')
+          c += regex[c + 1] == '\\' ? 2 : 1;
+        ++c;
+        end_current();
+      }
+      else if(chr == '(' || chr == ')') {
+        depth += chr == '(' ? 1 : -1;
+        end_current();
+      }
+      else if(chr == '|') {
+        if(depth == 0)
+          return std::string();
+      }
+      else if(chr == '?' || chr == '*' || chr == '{') {
+        // The quantified character is optional or repeated
+        if(!current.empty())
+          current.pop_back();
+        end_current();
+        if(chr == '{') {
+          while(c + 1 < regex.size() && regex[c + 1] != '}')
+            ++c;
+          ++c;
+        }
+      }
+      else if(chr == '+' || chr == '^' || chr == '$' || chr == '.' || chr == ']' || chr == '}')
+        end_current();
+      else if(depth == 0)
+        current += chr;
+    }
+    end_current();
+    return longest;
+  }
+
+  /// State of a search shared by the worker threads
+  class Search {
+  public:
+    boost::filesystem::path project_path;
+    std::shared_ptr<const std::vector<boost::filesystem::path>> files;
+    std::map<boost::filesystem::path, std::string> buffers;
+    std::function<void(const boost::filesystem::path &file, std::vector<FindInFiles::Match> &&matches)> on_matches;
+    std::function<void()> on_done;
+
+    /// Index of the next file to search
+    std::atomic<size_t> next_file = {0};
+
+    std::mutex mutex;
+    /// Matches of the searched files that are not yet passed to on_matches
+    std::vector<std::vector<FindInFiles::Match>> matches;
+    std::vector<bool> searched;
+    /// Index of the next file to pass to on_matches
+    size_t next_result = 0;
+    bool done = false;
+  };
+} // namespace
+
+FindInFiles::FindInFiles(const std::string &pattern, bool case_sensitive, bool regex_) : case_sensitive(case_sensitive) {
+  // Patterns without regular expression syntax are searched for as literal strings
+  if(regex_ && pattern.find_first_of("^$\\.*+?()[]{}|") != std::string::npos) {
+    auto flags = std::regex::ECMAScript | std::regex::optimize;
+    if(!case_sensitive)
+      flags |= std::regex::icase;
+    regex = std::make_unique<std::regex>(pattern, flags);
+    literal = get_required_literal(pattern);
+  }
+  else
+    literal = pattern;
+  if(!case_sensitive)
+    std::transform(literal.begin(), literal.end(), literal.begin(), ascii_tolower);
+}
+
+FindInFiles::~FindInFiles() {
+  cancel();
+}
+
+std::vector<FindInFiles::Match> FindInFiles::find(const char *text, size_t size) const {
+  std::vector<Match> matches;
+  if((!regex && literal.empty()) || std::memchr(text, '\0', std::min(size, binary_check_size)))
+    return matches;
+
+  auto end = text + size;
+  auto add_line = [this, &matches](size_t line, const char *line_begin, const char *line_end, const char *match) {
+    if(line_end > line_begin && *(line_end - 1) == '\r')
+      --line_end;
+    size_t match_size = literal.size();
+    if(regex) {
+      std::cmatch sm;
+      if(static_cast<size_t>(line_end - line_begin) > regex_max_line_size) {
+        if(!regex_search_long_line(line_begin, line_end, match, sm))
+          return;
+      }
+      else if(!std::regex_search(line_begin, line_end, sm, *regex))
+        return;
+      match = sm[0].first;
+      match_size = sm[0].length();
+    }
+    matches.emplace_back();
+    auto &new_match = matches.back();
+    new_match.line = line;
+    new_match.index = match - line_begin;
+    new_match.size = match_size;
+    new_match.line_text.assign(line_begin, line_end);
+  };
+
+  if(literal.empty()) {
+    size_t line = 0;
+    for(auto line_begin = text; line_begin < end; ++line) {
+      auto line_end = static_cast<const char *>(std::memchr(line_begin, '\n', end - line_begin));
+      if(!line_end)
+        line_end = end;
+      add_line(line, line_begin, line_end, line_begin);
+      line_begin = line_end + 1;
+    }
+    return matches;
+  }
+
+  // Only lines containing the literal string are searched, and newlines are only counted up to each occurrence
+  size_t line = 0;
+  auto line_begin = text, counted = text;
+  for(auto match = find_literal(text, end); match;) {
+    for(const char *newline; (newline = static_cast<const char *>(std::memchr(counted, '\n', match - counted))); counted = newline + 1) {
+      ++line;
+      line_begin = newline + 1;
+    }
+    counted = match;
+    auto match_end = match + literal.size();
+    auto line_end = static_cast<const char *>(std::memchr(match_end, '\n', end - match_end));
+    if(!line_end)
+      line_end = end;
+    add_line(line, line_begin, line_end, match);
+    // Only the first match of each line is added
+    match = line_end < end ? find_literal(line_end + 1, end) : nullptr;
+  }
+  return matches;
+}
+
+std::vector<FindInFiles::Match> FindInFiles::find(const boost::filesystem::path &path) const {
+#ifdef _WIN32
+  std::ifstream stream(path.string(), std::ifstream::binary);
+  if(!stream)
+    return {};
+  std::string text(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+  return find(text.data(), text.size());
+#else
+  auto fd = ::open(path.string().c_str(), O_RDONLY);
+  if(fd < 0)
+    return {};
+  std::vector<Match> matches;
+  struct stat status;
+  if(fstat(fd, &status) == 0 && status.st_size > 0) {
+    if(static_cast<size_t>(status.st_size) < mmap_min_size) {
+      thread_local std::string buffer;
+      buffer.resize(status.st_size);
+      size_t size = 0;
+      for(ssize_t n; size < buffer.size() && (n = ::read(fd, &buffer[size], buffer.size() - size)) > 0;)
+        size += n;
+      matches = find(buffer.data(), size);
+    }
+    else {
+      auto address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(address != MAP_FAILED) {
+        matches = find(static_cast<const char *>(address), status.st_size);
+        munmap(address, status.st_size);
+      }
+    }
+  }
+  close(fd);
+  return matches;
+#endif
+}
+
+void FindInFiles::search(boost::filesystem::path project_path, std::shared_ptr<const std::vector<boost::filesystem::path>> files, std::map<boost::filesystem::path, std::string> buffers,
+                         std::function<void(const boost::filesystem::path &file, std::vector<Match> &&matches)> on_matches, std::function<void()> on_done) {
+  cancel();
+  canceled = false;
+
+  auto search = std::make_shared<Search>();
+  search->project_path = std::move(project_path);
+  search->files = std::move(files);
+  search->buffers = std::move(buffers);
+  search->on_matches = std::move(on_matches);
+  search->on_done = std::move(on_done);
+  search->matches.resize(search->files->size());
+  search->searched.resize(search->files->size(), false);
+
+  auto thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(search->files->size(), 1));
+  for(size_t c = 0; c < thread_count; ++c) {
+    threads.emplace_back([this, search] {
+      auto &files = *search->files;
+      size_t index;
+      while(!canceled && (index = search->next_file++) < files.size()) {
+        auto path = search->project_path / files[index];
+        auto it = search->buffers.find(path);
+        auto matches = it != search->buffers.end() ? find(it->second.data(), it->second.size()) : find(path);
+
+        // Matches are passed on in the order of the files
+        std::unique_lock<std::mutex> lock(search->mutex);
+        search->matches[index] = std::move(matches);
+        search->searched[index] = true;
+        for(; search->next_result < files.size() && search->searched[search->next_result]; ++search->next_result) {
+          auto matches = std::move(search->matches[search->next_result]);
+          if(!matches.empty() && !canceled)
+            search->on_matches(files[search->next_result], std::move(matches));
+        }
+      }
+
+      std::unique_lock<std::mutex> lock(search->mutex);
+      if(!canceled && !search->done && search->next_result == files.size()) {
+        search->done = true;
+        if(search->on_done)
+          search->on_done();
+      }
+    });
+  }
+}
+
+void FindInFiles::wait() {
+  for(auto &thread : threads)
+    thread.join();
+  threads.clear();
+}
+
+void FindInFiles::cancel() {
+  canceled = true;
+  wait();
+}
+
+bool FindInFiles::regex_search_long_line(const char *line_begin, const char *line_end, const char *match, std::cmatch &sm) const {
+  // The windows overlap by half their size, so that every match of at most half the window size is within a window
+  auto step_size = regex_max_line_size / 2;
+  auto window_begin = line_begin + std::max<size_t>((match - line_begin) / step_size, 1) * step_size - step_size;
+  while(true) {
+    auto window_end = static_cast<size_t>(line_end - window_begin) > regex_max_line_size ? window_begin + regex_max_line_size : line_end;
+    // Windows without an occurrence of literal cannot contain a match
+    if(literal.empty() || find_literal(window_begin, window_end)) {
+      auto flags = std::regex_constants::match_default;
+      if(window_begin > line_begin)
+        flags |= std::regex_constants::match_not_bol | std::regex_constants::match_prev_avail;
+      if(window_end < line_end)
+        flags |= std::regex_constants::match_not_eol;
+      if(std::regex_search(window_begin, window_end, sm, *regex, flags))
+        return true;
+    }
+    if(window_end == line_end)
+      return false;
+    window_begin += step_size;
+  }
+}
+
+const char *FindInFiles::find_literal(const char *begin, const char *end) const {
+  auto size = literal.size();
+  if(static_cast<size_t>(end - begin) < size)
+    return nullptr;
+  auto last = end - size + 1; // Past the last position a match can start at
+  auto rest_equal = [this, size](const char *match) {
+    if(case_sensitive)
+      return std::memcmp(match + 1, literal.data() + 1, size - 1) == 0;
+    for(size_t c = 1; c < size; ++c) {
+      if(ascii_tolower(match[c]) != literal[c])
+        return false;
+    }
+    return true;
+  };
+
+  auto first_lower = literal[0], first_upper = case_sensitive ? literal[0] : ascii_toupper(literal[0]);
+  if(first_lower == first_upper) {
+    for(auto chr = begin; (chr = static_cast<const char *>(std::memchr(chr, first_lower, last - chr))); ++chr) {
+      if(rest_equal(chr))
+        return chr;
+    }
+    return nullptr;
+  }
+
+  // Both cases of the first letter are scanned for a block at a time,
+  // so that scanning for one case does not run far past an earlier match starting with the other case
+  for(auto block = begin; block < last;) {
+    auto block_end = static_cast<size_t>(last - block) > scan_block_size ? block + scan_block_size : last;
+    auto lower = static_cast<const char *>(std::memchr(block, first_lower, block_end - block));
+    auto upper = static_cast<const char *>(std::memchr(block, first_upper, block_end - block));
+    while(lower || upper) {
+      if(lower && (!upper || lower < upper)) {
+        if(rest_equal(lower))
+          return lower;
+        lower = static_cast<const char *>(std::memchr(lower + 1, first_lower, block_end - (lower + 1)));
+      }
+      else {
+        if(rest_equal(upper))
+          return upper;
+        upper = static_cast<const char *>(std::memchr(upper + 1, first_upper, block_end - (upper + 1)));
+      }
+    }
+    block = block_end;
+  }
+  return nullptr;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Finds the lines of files that contain a literal string or match a regular expression.
+/// Literal strings are scanned for with memchr and memcmp. For regular expressions, a string that every match contains is scanned for
+/// the same way when possible, and std::regex is only run on the lines containing it.
+class FindInFiles {
+public:
+  class Match {
+  public:
+    /// Line number, starting at 0
+    size_t line;
+    /// Byte index of the match in the line
+    size_t index;
+    /// Size of the match in bytes
+    size_t size;
+    /// The line without line ending
+    std::string line_text;
+  };
+
+  /// Throws std::regex_error if regex is true and pattern is not a valid regular expression.
+  /// If case_sensitive is false, literal strings are matched ignoring the case of ASCII letters.
+  FindInFiles(const std::string &pattern, bool case_sensitive = true, bool regex = false);
+  ~FindInFiles();
+
+  /// Returns the first match of each matching line in text.
+  /// Text with a null character in its first 8000 bytes is considered binary, like git does, and has no matches.
+  std::vector<Match> find(const char *text, size_t size) const;
+  /// Returns the matches in the file at path, or no matches if the file could not be read. Large files are mapped to memory.
+  std::vector<Match> find(const boost::filesystem::path &path) const;
+
+  /// Starts searching files, relative to project_path, in a pool of worker threads.
+  /// The texts in buffers, with absolute file paths as keys, are searched instead of the files on disk.
+  /// on_matches is called for each file with matches, in the order of files, and on_done is called when all the files are searched.
+  /// Both are called from the worker threads, one call at a time, and not at all after cancel().
+  void search(boost::filesystem::path project_path, std::shared_ptr<const std::vector<boost::filesystem::path>> files, std::map<boost::filesystem::path, std::string> buffers,
+              std::function<void(const boost::filesystem::path &file, std::vector<Match> &&matches)> on_matches, std::function<void()> on_done = nullptr);
+  /// Waits for the search to finish
+  void wait();
+  /// Stops the search in progress, and waits for the worker threads to finish
+  void cancel();
+
+private:
+  /// The literal pattern, or a string that every match of regex contains. Lowercase if not case_sensitive.
+  std::string literal;
+  bool case_sensitive;
+  /// Only set if the pattern is a regular expression
+  std::unique_ptr<std::regex> regex;
+
+  std::vector<std::thread> threads;
+  std::atomic<bool> canceled = {false};
+
+  /// Returns the first occurrence of literal in [begin, end), or nullptr if there is none
+  const char *find_literal(const char *begin, const char *end) const;
+  /// Runs regex on a line that is too long to be searched at once, in overlapping windows from the window containing match,
+  /// the first occurrence of literal in the line. Only matches of at most half the window size are certain to be found.
+  bool regex_search_long_line(const char *line_begin, const char *line_end, const char *match, std::cmatch &sm) const;
+};
@@ -0,0 +1,216 @@
+#include "fuzzy_match.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+  const int score_match = 16;
+  const int penalty_gap_start = 3;
+  const int penalty_gap_extension = 1;
+  const int bonus_path_separator = 9;
+  const int bonus_boundary = 8;
+  const int bonus_camel_case = 7;
+  const int bonus_consecutive = penalty_gap_start + penalty_gap_extension;
+  const int bonus_first_character_multiplier = 2;
+  const int bonus_case = 1;
+
+  enum class CharClass { path_separator, delimiter, lower, upper, digit };
+
+  CharClass get_char_class(unsigned char chr) {
+    if(chr >= 'a' && chr <= 'z')
+      return CharClass::lower;
+    if(chr >= 'A' && chr <= 'Z')
+      return CharClass::upper;
+    if(chr >= '0' && chr <= '9')
+      return CharClass::digit;
+    if(chr == '/' || chr == '\\')
+      return CharClass::path_separator;
+    if(chr >= 128) // Parts of UTF-8 characters
+      return CharClass::lower;
+    return CharClass::delimiter;
+  }
+
+  int get_bonus(CharClass previous, CharClass current) {
+    if(current == CharClass::path_separator || current == CharClass::delimiter)
+      return 0;
+    if(previous == CharClass::path_separator)
+      return bonus_path_separator;
+    if(previous == CharClass::delimiter)
+      return bonus_boundary;
+    if((previous == CharClass::lower && current == CharClass::upper) || (previous != CharClass::digit && current == CharClass::digit))
+      return bonus_camel_case;
+    return 0;
+  }
+
+  char to_lower(char chr) {
+    return chr >= 'A' && chr <= 'Z' ? chr - 'A' + 'a' : chr;
+  }
+} // namespace
+
+FuzzyMatcher::Query::Query(std::string text_) : text(std::move(text_)), text_lc(text), mask(0) {
+  for(auto &chr : text_lc) {
+    chr = to_lower(chr);
+    mask |= get_mask(chr);
+  }
+}
+
+void FuzzyMatcher::add(const std::string &text, bool markup) {
+  Row row;
+  row.offset = texts.size();
+  if(markup) {
+    for(size_t c = 0; c < text.size(); ++c) {
+      if(text[c] == '<') {
+        c = text.find('>', c + 1);
+        if(c == std::string::npos)
+          break;
+      }
+      else if(text[c] == '&') {
+        static const std::vector<std::pair<std::string, char>> entities = {{"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}, {"&quot;", '"'}, {"&apos;", '\''}};
+        auto it = std::find_if(entities.begin(), entities.end(), [&text, c](const std::pair<std::string, char> &entity) {
+          return text.compare(c, entity.first.size(), entity.first) == 0;
+        });
+        if(it != entities.end()) {
+          texts += it->second;
+          c += it->first.size() - 1;
+        }
+        else
+          texts += '&';
+      }
+      else
+        texts += text[c];
+    }
+  }
+  else
+    texts += text;
+  row.size = texts.size() - row.offset;
+
+  row.mask = 0;
+  for(size_t c = row.offset; c < texts.size(); ++c) {
+    texts_lc += to_lower(texts[c]);
+    row.mask |= get_mask(texts_lc.back());
+  }
+  rows.emplace_back(row);
+}
+
+void FuzzyMatcher::clear() {
+  texts.clear();
+  texts_lc.clear();
+  rows.clear();
+}
+
+int FuzzyMatcher::score(const Query &query, size_t index) const {
+  auto &row = rows[index];
+  if((row.mask & query.mask) != query.mask)
+    return no_match;
+  return score(query, texts.data() + row.offset, texts_lc.data() + row.offset, row.size);
+}
+
+std::vector<unsigned int> FuzzyMatcher::find(const std::string &query_text, size_t max_results, const std::function<bool()> &is_canceled) const {
+  std::vector<unsigned int> indices;
+  if(query_text.empty()) {
+    indices.reserve(std::min(rows.size(), max_results));
+    for(size_t index = 0; index < rows.size() && index < max_results; ++index)
+      indices.emplace_back(index);
+    return indices;
+  }
+
+  Query query(query_text);
+  std::vector<std::pair<int, unsigned int>> matches;
+  for(size_t index = 0; index < rows.size(); ++index) {
+    if(is_canceled && index % 4096 == 0 && is_canceled())
+      return indices;
+    auto score = this->score(query, index);
+    if(score != no_match)
+      matches.emplace_back(score, index);
+  }
+
+  auto compare = [this](const std::pair<int, unsigned int> &lhs, const std::pair<int, unsigned int> &rhs) {
+    if(lhs.first != rhs.first)
+      return lhs.first > rhs.first;
+    if(rows[lhs.second].size != rows[rhs.second].size)
+      return rows[lhs.second].size < rows[rhs.second].size;
+    return lhs.second < rhs.second;
+  };
+  if(matches.size() > max_results) {
+    std::partial_sort(matches.begin(), matches.begin() + max_results, matches.end(), compare);
+    matches.resize(max_results);
+  }
+  else
+    std::sort(matches.begin(), matches.end(), compare);
+
+  indices.reserve(matches.size());
+  for(auto &match : matches)
+    indices.emplace_back(match.second);
+  return indices;
+}
+
+int FuzzyMatcher::score(const std::string &query, const std::string &text) {
+  std::string text_lc(text);
+  for(auto &chr : text_lc)
+    chr = to_lower(chr);
+  return score(Query(query), text.data(), text_lc.data(), text.size());
+}
+
+uint64_t FuzzyMatcher::get_mask(unsigned char chr) {
+  if(chr >= 'a' && chr <= 'z')
+    return static_cast<uint64_t>(1) << (chr - 'a');
+  if(chr >= '0' && chr <= '9')
+    return static_cast<uint64_t>(1) << (26 + chr - '0');
+  return static_cast<uint64_t>(1) << (36 + chr % 28);
+}
+
+int FuzzyMatcher::score(const Query &query, const char *text, const char *text_lc, size_t size) {
+  auto &pattern = query.text_lc;
+  if(pattern.empty())
+    return 0;
+
+  // Find the end of the first occurrence of the pattern, and then the shortest match ending there by scanning backwards
+  size_t end = 0;
+  for(auto chr : pattern) {
+    auto position = static_cast<const char *>(std::memchr(text_lc + end, chr, size - end));
+    if(!position)
+      return no_match;
+    end = position - text_lc + 1;
+  }
+  size_t start = end;
+  for(auto it = pattern.rbegin(); it != pattern.rend(); ++it) {
+    do
+      --start;
+    while(text_lc[start] != *it);
+  }
+
+  int score = 0;
+  size_t pattern_index = 0;
+  bool in_gap = false;
+  size_t consecutive = 0;
+  int first_bonus = 0;
+  auto previous_class = start > 0 ? get_char_class(text[start - 1]) : CharClass::delimiter;
+  for(size_t c = start; c < end; ++c) {
+    auto current_class = get_char_class(text[c]);
+    if(text_lc[c] == pattern[pattern_index]) {
+      auto bonus = get_bonus(previous_class, current_class);
+      if(consecutive == 0)
+        first_bonus = bonus;
+      else {
+        // A consecutive chunk keeps the bonus of its first character, for instance a word boundary
+        if(bonus >= bonus_boundary && bonus > first_bonus)
+          first_bonus = bonus;
+        bonus = std::max(std::max(bonus, first_bonus), bonus_consecutive);
+      }
+      if(pattern_index == 0)
+        bonus *= bonus_first_character_multiplier;
+      score += score_match + bonus;
+      if(text[c] == query.text[pattern_index])
+        score += bonus_case;
+      in_gap = false;
+      ++consecutive;
+      ++pattern_index;
+    }
+    else {
+      score -= in_gap ? penalty_gap_extension : penalty_gap_start;
+      in_gap = true;
+      consecutive = 0;
+    }
+    previous_class = current_class;
+  }
+  return score;
+}
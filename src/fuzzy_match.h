@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+/// Case-insensitive subsequence matching and ranking of rows, for instance symbols or file paths.
+/// The lowercased text and a character bitmask of each row are computed once when the row is added,
+/// and rows whose bitmask lack characters of the query are skipped without being scanned.
+class FuzzyMatcher {
+public:
+  /// Returned by score() if the query is not a subsequence of the row
+  static const int no_match = std::numeric_limits<int>::min();
+
+  class Query {
+  public:
+    Query(std::string text);
+
+    std::string text;
+    std::string text_lc;
+    uint64_t mask;
+  };
+
+  /// Adds a row. If markup is true, markup tags are removed and entities are unescaped before matching.
+  void add(const std::string &text, bool markup = false);
+  void clear();
+  size_t size() const { return rows.size(); }
+
+  /// Returns the score of the row at index, where a higher score is a better match, or no_match.
+  /// Matches at word boundaries, camelCase humps and after path separators, and consecutive matches, score higher.
+  int score(const Query &query, size_t index) const;
+
+  /// Returns the indices of at most max_results rows that match query, ordered by descending score,
+  /// then by ascending row length and index. All indices are returned in order if query is empty.
+  /// If is_canceled is set, it is called regularly, and an empty vector is returned when it returns true.
+  std::vector<unsigned int> find(const std::string &query, size_t max_results = std::numeric_limits<size_t>::max(),
+                                 const std::function<bool()> &is_canceled = nullptr) const;
+
+  /// Returns the score of text, see score() above
+  static int score(const std::string &query, const std::string &text);
+
+private:
+  class Row {
+  public:
+    size_t offset;
+    size_t size;
+    uint64_t mask;
+  };
+
+  /// Row texts, without markup, stored contiguously
+  std::string texts;
+  std::string texts_lc;
+  std::vector<Row> rows;
+
+  static uint64_t get_mask(unsigned char chr);
+  static int score(const Query &query, const char *text, const char *text_lc, size_t size);
+};
@@ -273,6 +273,17 @@ std::string Git::Repository::get_branch() noexcept {
   return branch;
 }
 
+bool Git::Repository::is_ignored(const boost::filesystem::path &path, bool is_directory) noexcept {
+  auto path_string = path.generic_string();
+  if(is_directory)
+    path_string += '/'; // Patterns ending with / only match directories
+  int ignored = 0;
+  std::lock_guard<std::mutex> lock(mutex);
+  if(git_ignore_path_is_ignored(&ignored, repository.get(), path_string.c_str()) < 0)
+    return false;
+  return ignored == 1;
+}
+
 void Git::initialize() noexcept {
   std::lock_guard<std::mutex> lock(mutex);
   if(!initialized) {
@@ -92,6 +92,9 @@ public:
 
     std::string get_branch() noexcept;
 
+    /// Returns true if path, relative to the work path, is ignored through .gitignore files or the exclude files of the repository
+    bool is_ignored(const boost::filesystem::path &path, bool is_directory = false) noexcept;
+
     Glib::RefPtr<Gio::FileMonitor> monitor;
   };
 
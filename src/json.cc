@@ -0,0 +1,177 @@
+#include "json.h"
+#include <stdexcept>
+
+bool JSONReader::consume(char chr) {
+  skip_whitespace();
+  if(pos < end && *pos == chr) {
+    ++pos;
+    return true;
+  }
+  return false;
+}
+
+void JSONReader::expect(char chr) {
+  if(!consume(chr))
+    throw std::runtime_error(std::string("expected ") + chr);
+}
+
+void JSONReader::read_string(std::string &str) {
+  expect('"');
+  str.clear();
+  while(true) {
+    auto start = pos;
+    while(pos < end && *pos != '"' && *pos != '\\')
+      ++pos;
+    str.append(start, pos);
+    if(pos >= end)
+      throw std::runtime_error("unterminated string");
+    if(*pos++ == '"')
+      return;
+    if(pos >= end)
+      throw std::runtime_error("unterminated string");
+    auto chr = *pos++;
+    switch(chr) {
+    case 'b': str += '\b'; break;
+    case 'f': str += '\f'; break;
+    case 'n': str += '\n'; break;
+    case 'r': str += '\r'; break;
+    case 't': str += '\t'; break;
+    case 'u': append_utf8(str, read_code_point()); break;
+    default: str += chr;
+    }
+  }
+}
+
+void JSONReader::skip_value() {
+  skip_whitespace();
+  if(pos >= end)
+    throw std::runtime_error("unexpected end");
+  if(*pos == '"') {
+    std::string str;
+    read_string(str);
+  }
+  else if(*pos == '{' || *pos == '[') {
+    auto close = *pos == '{' ? '}' : ']';
+    ++pos;
+    if(consume(close))
+      return;
+    do {
+      if(close == '}') {
+        std::string key;
+        read_string(key);
+        expect(':');
+      }
+      skip_value();
+    } while(consume(','));
+    expect(close);
+  }
+  else {
+    while(pos < end && *pos != ',' && *pos != '}' && *pos != ']' && *pos != ' ' && *pos != '\t' && *pos != '\n' && *pos != '\r')
+      ++pos;
+  }
+}
+
+void JSONReader::read(boost::property_tree::ptree &pt) {
+  skip_whitespace();
+  if(pos >= end)
+    throw std::runtime_error("unexpected end");
+  if(*pos == '"')
+    read_string(pt.data());
+  else if(*pos == '{') {
+    ++pos;
+    if(consume('}'))
+      return;
+    std::string key;
+    do {
+      read_string(key);
+      expect(':');
+      auto it = pt.push_back(std::make_pair(key, boost::property_tree::ptree()));
+      if(!raw_key.empty() && key == raw_key) {
+        skip_whitespace();
+        auto start = pos;
+        read(it->second);
+        it->second.data().assign(start, pos);
+      }
+      else
+        read(it->second);
+    } while(consume(','));
+    expect('}');
+  }
+  else if(*pos == '[') {
+    ++pos;
+    if(consume(']'))
+      return;
+    do {
+      auto it = pt.push_back(std::make_pair(std::string(), boost::property_tree::ptree()));
+      read(it->second);
+    } while(consume(','));
+    expect(']');
+  }
+  else {
+    // Numbers and literals are stored as strings, like in boost::property_tree::read_json
+    auto start = pos;
+    while(pos < end && *pos != ',' && *pos != '}' && *pos != ']' && *pos != ' ' && *pos != '\t' && *pos != '\n' && *pos != '\r')
+      ++pos;
+    if(start == pos)
+      throw std::runtime_error("expected value");
+    pt.data().assign(start, pos);
+  }
+}
+
+bool JSONReader::at_end() {
+  skip_whitespace();
+  return pos >= end;
+}
+
+void JSONReader::skip_whitespace() {
+  while(pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+    ++pos;
+}
+
+unsigned JSONReader::read_hex() {
+  if(end - pos < 4)
+    throw std::runtime_error("invalid unicode escape");
+  unsigned value = 0;
+  for(int c = 0; c < 4; ++c, ++pos) {
+    value <<= 4;
+    if(*pos >= '0' && *pos <= '9')
+      value += *pos - '0';
+    else if(*pos >= 'a' && *pos <= 'f')
+      value += *pos - 'a' + 10;
+    else if(*pos >= 'A' && *pos <= 'F')
+      value += *pos - 'A' + 10;
+    else
+      throw std::runtime_error("invalid unicode escape");
+  }
+  return value;
+}
+
+unsigned JSONReader::read_code_point() {
+  auto code_point = read_hex();
+  if(code_point >= 0xD800 && code_point <= 0xDBFF && end - pos >= 6 && pos[0] == '\\' && pos[1] == 'u') {
+    pos += 2;
+    auto low = read_hex();
+    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+  }
+  return code_point;
+}
+
+void JSONReader::append_utf8(std::string &str, unsigned code_point) {
+  if(code_point < 0x80)
+    str += static_cast<char>(code_point);
+  else if(code_point < 0x800) {
+    str += static_cast<char>(0xC0 | (code_point >> 6));
+    str += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+  else if(code_point < 0x10000) {
+    str += static_cast<char>(0xE0 | (code_point >> 12));
+    str += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+  else {
+    str += static_cast<char>(0xF0 | (code_point >> 18));
+    str += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    str += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <boost/property_tree/ptree.hpp>
+#include <string>
+
+/// Single pass JSON reader working directly on a character buffer.
+/// Values can be read into strings, skipped, or read into property trees with the same layout as
+/// boost::property_tree::read_json produces. Throws std::runtime_error on invalid JSON.
+class JSONReader {
+public:
+  JSONReader(const char *begin, const char *end) : pos(begin), end(end) {}
+  JSONReader(const std::string &text) : JSONReader(text.data(), text.data() + text.size()) {}
+
+  /// Returns true and moves past chr if chr is the next non-whitespace character
+  bool consume(char chr);
+  void expect(char chr);
+
+  void read_string(std::string &str);
+  void skip_value();
+  void read(boost::property_tree::ptree &pt);
+
+  /// Returns true if only whitespace remains
+  bool at_end();
+
+  /// If not empty, read() also stores the JSON text of the values of object members with this key, unchanged,
+  /// as the data of their property trees. Strings are then stored with their quotes and escape sequences.
+  std::string raw_key;
+
+private:
+  const char *pos, *end;
+
+  void skip_whitespace();
+  unsigned read_hex();
+  unsigned read_code_point();
+  static void append_utf8(std::string &str, unsigned code_point);
+};
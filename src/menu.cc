@@ -196,6 +196,10 @@ const Glib::ustring menu_xml = R"RAW(<interface>
           <attribute name='label' translatable='yes'>_Find</attribute>
           <attribute name='action'>app.edit_find</attribute>
         </item>
+        <item>
+          <attribute name='label' translatable='yes'>_Find in _Files</attribute>
+          <attribute name='action'>app.edit_find_in_files</attribute>
+        </item>
       </section>
     </submenu>
 
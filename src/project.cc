@@ -6,6 +6,7 @@
 #include "notebook.h"
 #include "selection_dialog.h"
 #include "terminal.h"
+#include <algorithm>
 #include <fstream>
 #ifdef JUCI_ENABLE_DEBUG
 #include "debug_lldb.h"
@@ -163,6 +164,17 @@ std::shared_ptr<Project::Base> Project::create() {
   return std::shared_ptr<Project::Base>(new Project::Base(std::move(build)));
 }
 
+void Project::prestart_language_server(const Build &build) {
+  if(build.project_path.empty())
+    return;
+  if(dynamic_cast<const CargoBuild *>(&build))
+    ::LanguageProtocol::Client::prestart(build.project_path, "rust");
+  else if(dynamic_cast<const NpmBuild *>(&build))
+    ::LanguageProtocol::Client::prestart(build.project_path, "javascript");
+  else if(dynamic_cast<const PythonMain *>(&build))
+    ::LanguageProtocol::Client::prestart(build.project_path, "python");
+}
+
 std::pair<std::string, std::string> Project::Base::get_run_arguments() {
   Info::get().print("Could not find a supported project");
   return {"", ""};
@@ -196,16 +208,12 @@ void Project::Base::show_symbols() {
       return;
     }
   }
-  auto pair = Ctags::get_result(search_path);
-
-  auto path = std::move(pair.first);
-  auto stream = std::move(pair.second);
-  stream->seekg(0, std::ios::end);
-  if(stream->tellg() == 0) {
+  auto index = Ctags::Index::get(search_path);
+  auto tags = index->try_get_tags();
+  if(tags && tags->empty()) {
     Info::get().print("No symbols found in current project");
     return;
   }
-  stream->seekg(0, std::ios::beg);
 
   if(view) {
     auto dialog_iter = view->get_iter_for_dialog();
@@ -214,23 +222,46 @@ void Project::Base::show_symbols() {
   else
     SelectionDialog::create(true, true);
 
-  std::vector<Source::Offset> rows;
+  auto rows = std::make_shared<std::vector<Source::Offset>>();
+  auto add_rows = [](std::vector<Source::Offset> &rows, const char *tags, size_t size) {
+    for(auto line = tags, end = tags + size; line < end;) {
+      auto line_end = std::find(line, end, '\n');
+      auto location = Ctags::get_location(line, line_end - line, true);
+      line = line_end == end ? end : line_end + 1;
 
-  std::string line;
-  while(std::getline(*stream, line)) {
-    auto location = Ctags::get_location(line, true);
+      std::string row = location.file_path.string() + ":" + std::to_string(location.line + 1) + ": " + location.source;
+      rows.emplace_back(Source::Offset(location.line, location.index, location.file_path));
+      SelectionDialog::get()->add_row(row);
+    }
+  };
 
-    std::string row = location.file_path.string() + ":" + std::to_string(location.line + 1) + ": " + location.source;
-    rows.emplace_back(Source::Offset(location.line, location.index, location.file_path));
-    SelectionDialog::get()->add_row(row);
+  // While the index is being built, symbols are added to the dialog as ctags finds them
+  std::shared_ptr<void> tags_listener;
+  if(!tags) {
+    auto self = shared_from_this();
+    tags_listener = index->add_tags_listener([dispatcher = &dispatcher, rows = std::weak_ptr<std::vector<Source::Offset>>(rows), add_rows](std::shared_ptr<const std::string> tags) {
+      dispatcher->post([rows, add_rows, tags = std::move(tags)] {
+        auto locked_rows = rows.lock();
+        if(locked_rows && SelectionDialog::get() && SelectionDialog::get()->is_visible())
+          add_rows(*locked_rows, tags->data(), tags->size());
+      });
+    });
+    if(tags_listener) {
+      // Keeps this project, and thereby dispatcher, alive until the tags listener is removed
+      tags_listener = std::shared_ptr<void>(nullptr, [tags_listener, self](void *) mutable {
+        tags_listener = nullptr;
+      });
+    }
+    else
+      tags = index->try_get_tags();
   }
+  if(tags)
+    add_rows(*rows, tags->data(), tags->size());
 
-  if(rows.size() == 0)
-    return;
-  SelectionDialog::get()->on_select = [rows = std::move(rows), path = std::move(path)](unsigned int index, const std::string &text, bool hide_window) {
-    if(index >= rows.size())
+  SelectionDialog::get()->on_select = [rows, path = index->run_path, tags_listener](unsigned int index, const std::string &text, bool hide_window) {
+    if(index >= rows->size())
       return;
-    auto offset = rows[index];
+    auto offset = (*rows)[index];
     auto full_path = path / offset.file_path;
     if(!boost::filesystem::is_regular_file(full_path))
       return;
@@ -698,50 +729,75 @@ void Project::LanguageProtocol::show_symbols() {
 
   auto locations = std::make_shared<std::vector<::LanguageProtocol::Location>>();
   if(capabilities.workspace_symbol) {
-    SelectionDialog::get()->on_search_entry_changed = [client, project_path, locations](const std::string &text) {
-      if(text.size() > 1)
-        return;
-      else {
-        locations->clear();
-        SelectionDialog::get()->erase_rows();
-        if(text.empty())
-          return;
-      }
+    // Symbols are streamed into the dialog as partial results arrive.
+    // A new query cancels the previous one, and results of earlier queries are ignored.
+    static size_t query_count = 0;
+    auto current_query = std::make_shared<size_t>(++query_count);
+    auto progress_token = std::make_shared<std::string>();
+    auto self = shared_from_this();
+    auto add_symbols = [self, project_path, locations, current_query](const boost::property_tree::ptree &symbols, size_t query) {
+      std::vector<::LanguageProtocol::Location> new_locations;
       std::vector<std::string> rows;
-      std::promise<void> result_processed;
-      client->write_request(nullptr, "workspace/symbol", R"("query":")" + text + '"', [&result_processed, &rows, locations, project_path](const boost::property_tree::ptree &result, bool error) {
-        if(!error) {
-          for(auto it = result.begin(); it != result.end(); ++it) {
-            try {
-              ::LanguageProtocol::Location location(it->second.get_child("location"));
-              if(filesystem::file_in_path(location.file, *project_path)) {
-                ::LanguageProtocol::Location location(it->second.get_child("location"));
-
-                std::string row = filesystem::get_relative_path(location.file, *project_path).string() + ':';
-                auto container_name = it->second.get<std::string>("containerName", "");
-                if(!container_name.empty() && container_name != "null")
-                  row += container_name + ':';
-                row += std::to_string(location.range.start.line + 1) + ": <b>" + it->second.get<std::string>("name") + "</b>";
-
-                locations->emplace_back(std::move(location));
-                rows.emplace_back(std::move(row));
-              }
-            }
-            catch(...) {
-            }
+      for(auto it = symbols.begin(); it != symbols.end(); ++it) {
+        try {
+          ::LanguageProtocol::Location location(it->second.get_child("location"));
+          if(filesystem::file_in_path(location.file, *project_path)) {
+            std::string row = filesystem::get_relative_path(location.file, *project_path).string() + ':';
+            auto container_name = it->second.get<std::string>("containerName", "");
+            if(!container_name.empty() && container_name != "null")
+              row += container_name + ':';
+            row += std::to_string(location.range.start.line + 1) + ": <b>" + it->second.get<std::string>("name") + "</b>";
+
+            new_locations.emplace_back(std::move(location));
+            rows.emplace_back(std::move(row));
           }
         }
-        result_processed.set_value();
+        catch(...) {
+        }
+      }
+      if(rows.empty())
+        return;
+      self->dispatcher.post([locations, current_query, query, new_locations = std::move(new_locations), rows = std::move(rows)]() mutable {
+        if(query != *current_query || !SelectionDialog::get())
+          return;
+        for(size_t c = 0; c < rows.size(); ++c) {
+          locations->emplace_back(std::move(new_locations[c]));
+          SelectionDialog::get()->add_row(rows[c]);
+        }
+      });
+    };
+
+    SelectionDialog::get()->on_hide = [client = std::weak_ptr<::LanguageProtocol::Client>(client), current_query, progress_token] {
+      *current_query = ++query_count;
+      if(auto locked_client = client.lock())
+        locked_client->remove_progress_handler(*progress_token);
+      SelectionDialog::get()->on_search_entry_changed = nullptr; // To delete client object
+    };
+
+    SelectionDialog::get()->on_search_entry_changed = [client, locations, current_query, progress_token, add_symbols](const std::string &text) {
+      if(text.size() > 1)
+        return;
+      auto query = *current_query = ++query_count;
+      client->remove_progress_handler(*progress_token);
+      locations->clear();
+      SelectionDialog::get()->erase_rows();
+      if(text.empty())
+        return;
+
+      *progress_token = "workspace_symbol_" + std::to_string(query);
+      client->add_progress_handler(*progress_token, [add_symbols, query](const boost::property_tree::ptree &value) {
+        add_symbols(value, query);
       });
-      result_processed.get_future().get();
-      for(auto &row : rows)
-        SelectionDialog::get()->add_row(row);
+      client->write_request(nullptr, "workspace/symbol", R"("query":")" + text + R"(","partialResultToken":")" + *progress_token + '"', [add_symbols, query](const boost::property_tree::ptree &result, bool error) {
+        if(!error)
+          add_symbols(result, query);
+      }, "workspace_symbol");
     };
   }
   else {
     std::vector<std::string> rows;
     std::promise<void> result_processed;
-    client->write_request(language_protocol_view, "textDocument/documentSymbol", R"("textDocument":{"uri":"file://)" + language_protocol_view->file_path.string() + "\"}", [&result_processed, &rows, locations](const boost::property_tree::ptree &result, bool error) {
+    language_protocol_view->write_cached_request("textDocument/documentSymbol", "", "", [&result_processed, &rows, locations](const boost::property_tree::ptree &result, bool error) {
       if(!error) {
         for(auto it = result.begin(); it != result.end(); ++it) {
           try {
@@ -164,5 +164,8 @@ namespace Project {
   };
 
   std::shared_ptr<Base> create();
+  /// Starts the language server of the Rust, JavaScript or Python project of build in the background,
+  /// see ::LanguageProtocol::Client::prestart.
+  void prestart_language_server(const Build &build);
   extern std::shared_ptr<Base> current;
 }; // namespace Project
@@ -0,0 +1,266 @@
+#include "project_files.h"
+#include "filesystem.h"
+#include "project_build.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+  std::mutex project_files_mutex;
+  std::map<boost::filesystem::path, std::shared_ptr<ProjectFiles>> project_files_map;
+} // namespace
+
+ProjectFiles::ProjectFiles(boost::filesystem::path project_path_, std::vector<boost::filesystem::path> exclude_paths_, std::shared_ptr<Git::Repository> repository_, bool monitored)
+    : project_path(std::move(project_path_)), exclude_paths(std::move(exclude_paths_)), repository(std::move(repository_)), monitored(monitored) {
+  if(repository)
+    repository_relative_path = filesystem::get_relative_path(project_path, repository->get_work_path());
+}
+
+std::shared_ptr<ProjectFiles> ProjectFiles::get(const boost::filesystem::path &path) {
+  auto build = Project::Build::create(path);
+  auto project_path = build->project_path;
+  std::vector<boost::filesystem::path> exclude_paths;
+  if(!project_path.empty()) {
+    exclude_paths.emplace_back(filesystem::get_relative_path(build->get_default_path(), project_path));
+    exclude_paths.emplace_back(filesystem::get_relative_path(build->get_debug_path(), project_path));
+  }
+  else {
+    boost::system::error_code ec;
+    if(boost::filesystem::is_directory(path, ec) || ec)
+      project_path = path;
+    else
+      project_path = path.parent_path();
+  }
+
+  // Only the files of projects are cached and monitored, since a directory outside of projects can be large, for instance the home directory
+  bool monitored = !build->project_path.empty();
+  if(monitored) {
+    std::unique_lock<std::mutex> lock(project_files_mutex);
+    auto it = project_files_map.find(project_path);
+    if(it != project_files_map.end())
+      return it->second;
+  }
+
+  std::shared_ptr<Git::Repository> repository;
+  try {
+    repository = Git::get_repository(project_path);
+  }
+  catch(const std::exception &) {
+  }
+
+  auto project_files = std::shared_ptr<ProjectFiles>(new ProjectFiles(project_path, std::move(exclude_paths), std::move(repository), monitored));
+  if(monitored) {
+    std::unique_lock<std::mutex> lock(project_files_mutex);
+    project_files_map.emplace(project_path, project_files);
+  }
+
+  std::thread build_thread([project_files] {
+    ProjectFiles::build(project_files);
+  });
+  build_thread.detach();
+  return project_files;
+}
+
+std::shared_ptr<const std::vector<boost::filesystem::path>> ProjectFiles::get_files() {
+  std::unique_lock<std::mutex> lock(mutex);
+  condition_variable.wait(lock, [this] { return files != nullptr; });
+  return files;
+}
+
+std::shared_ptr<const std::vector<boost::filesystem::path>> ProjectFiles::try_get_files() {
+  std::unique_lock<std::mutex> lock(mutex);
+  return files;
+}
+
+std::shared_ptr<void> ProjectFiles::add_files_listener(std::function<void(std::shared_ptr<const std::vector<boost::filesystem::path>> files)> on_files) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if(files)
+    return nullptr;
+  if(!partial_files.empty())
+    on_files(std::make_shared<std::vector<boost::filesystem::path>>(partial_files));
+  auto id = ++files_listener_id;
+  files_listeners.emplace(id, std::move(on_files));
+  return std::shared_ptr<void>(nullptr, [project_files = shared_from_this(), id](void *) {
+    std::unique_lock<std::mutex> lock(project_files->mutex);
+    project_files->files_listeners.erase(id);
+  });
+}
+
+void ProjectFiles::update(const boost::filesystem::path &path) {
+  if(!filesystem::file_in_path(path, project_path))
+    return;
+  auto relative_path = filesystem::get_relative_path(path, project_path);
+  if(relative_path.empty())
+    return;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  pending_paths.emplace(std::move(relative_path));
+  if(!updating) {
+    updating = true;
+    std::thread update_thread([project_files = shared_from_this()] {
+      update_pending_paths(project_files);
+    });
+    update_thread.detach();
+  }
+}
+
+bool ProjectFiles::is_excluded(const boost::filesystem::path &relative_path, bool is_directory) const {
+  if(is_directory && (relative_path.filename() == ".git" || std::find(exclude_paths.begin(), exclude_paths.end(), relative_path) != exclude_paths.end()))
+    return true;
+  return repository && repository->is_ignored(repository_relative_path / relative_path, is_directory);
+}
+
+void ProjectFiles::add_files(const boost::filesystem::path &relative_directory, std::vector<boost::filesystem::path> &files, std::vector<boost::filesystem::path> &directories,
+                             const std::function<void(const std::vector<boost::filesystem::path> &files)> &on_directory_listed) const {
+  std::vector<boost::filesystem::path> unvisited_directories = {relative_directory};
+  while(!unvisited_directories.empty()) {
+    auto directory = std::move(unvisited_directories.back());
+    unvisited_directories.pop_back();
+
+    boost::system::error_code ec;
+    for(boost::filesystem::directory_iterator it(project_path / directory, ec), end; it != end; it.increment(ec)) {
+      auto relative_path = directory / it->path().filename();
+      // Symbolic links to directories are not followed
+      if(boost::filesystem::is_directory(it->symlink_status(ec))) {
+        if(!is_excluded(relative_path, true)) {
+          directories.emplace_back(relative_path);
+          unvisited_directories.emplace_back(std::move(relative_path));
+        }
+      }
+      else if(boost::filesystem::is_regular_file(it->status(ec))) {
+        if(!is_excluded(relative_path, false))
+          files.emplace_back(std::move(relative_path));
+      }
+    }
+    if(on_directory_listed)
+      on_directory_listed(files);
+  }
+}
+
+void ProjectFiles::add_monitors(const std::vector<boost::filesystem::path> &relative_directories) {
+  for(auto &relative_directory : relative_directories) {
+    auto path = project_path / relative_directory;
+    if(monitors.find(path) != monitors.end())
+      continue;
+    Glib::RefPtr<Gio::FileMonitor> monitor;
+    try {
+      monitor = Gio::File::create_for_path(path.string())->monitor_directory(Gio::FileMonitorFlags::FILE_MONITOR_WATCH_MOVES);
+    }
+    catch(const Glib::Error &) {
+      continue;
+    }
+    monitor->signal_changed().connect([this](const Glib::RefPtr<Gio::File> &file, const Glib::RefPtr<Gio::File> &other_file, Gio::FileMonitorEvent monitor_event) {
+      if(monitor_event == Gio::FileMonitorEvent::FILE_MONITOR_EVENT_CREATED ||
+         monitor_event == Gio::FileMonitorEvent::FILE_MONITOR_EVENT_MOVED_IN) {
+        update(file->get_path());
+      }
+      else if(monitor_event == Gio::FileMonitorEvent::FILE_MONITOR_EVENT_DELETED ||
+              monitor_event == Gio::FileMonitorEvent::FILE_MONITOR_EVENT_MOVED_OUT) {
+        remove_monitors(file->get_path());
+        update(file->get_path());
+      }
+      else if(monitor_event == Gio::FileMonitorEvent::FILE_MONITOR_EVENT_RENAMED) {
+        remove_monitors(file->get_path());
+        update(file->get_path());
+        if(other_file)
+          update(other_file->get_path());
+      }
+    });
+    monitors.emplace(std::move(path), std::move(monitor));
+  }
+}
+
+void ProjectFiles::remove_monitors(const boost::filesystem::path &path) {
+  auto it = monitors.lower_bound(path);
+  while(it != monitors.end() && filesystem::file_in_path(it->first, path))
+    it = monitors.erase(it);
+}
+
+void ProjectFiles::build(std::shared_ptr<ProjectFiles> project_files) {
+  auto files = std::make_shared<std::vector<boost::filesystem::path>>();
+  std::vector<boost::filesystem::path> directories = {boost::filesystem::path()};
+  size_t files_size = 0; // Number of files passed to the files listeners
+  project_files->add_files(boost::filesystem::path(), *files, directories, [&project_files, &files_size](const std::vector<boost::filesystem::path> &files) {
+    if(files.size() == files_size)
+      return;
+    std::unique_lock<std::mutex> lock(project_files->mutex);
+    project_files->partial_files.insert(project_files->partial_files.end(), files.begin() + files_size, files.end());
+    if(!project_files->files_listeners.empty()) {
+      auto new_files = std::make_shared<std::vector<boost::filesystem::path>>(files.begin() + files_size, files.end());
+      for(auto &files_listener : project_files->files_listeners)
+        files_listener.second(new_files);
+    }
+    files_size = files.size();
+  });
+  std::sort(files->begin(), files->end());
+
+  {
+    std::unique_lock<std::mutex> lock(project_files->mutex);
+    project_files->files = std::move(files);
+    project_files->building = false;
+    project_files->partial_files.clear();
+    project_files->partial_files.shrink_to_fit();
+    project_files->files_listeners.clear();
+  }
+  project_files->condition_variable.notify_all();
+
+  if(project_files->monitored) {
+    project_files->dispatcher.post([project_files, directories = std::move(directories)] {
+      project_files->add_monitors(directories);
+    });
+  }
+}
+
+void ProjectFiles::update_pending_paths(std::shared_ptr<ProjectFiles> project_files) {
+  std::unique_lock<std::mutex> lock(project_files->mutex);
+  // Paths changed while the files are listed might not be reflected in the file list
+  project_files->condition_variable.wait(lock, [&project_files] { return !project_files->building; });
+  while(!project_files->pending_paths.empty()) {
+    auto paths = std::move(project_files->pending_paths);
+    project_files->pending_paths.clear();
+    auto files = project_files->files;
+    lock.unlock();
+
+    std::vector<boost::filesystem::path> added_files, added_directories;
+    for(auto &relative_path : paths) {
+      boost::system::error_code ec;
+      auto path = project_files->project_path / relative_path;
+      if(boost::filesystem::is_directory(boost::filesystem::symlink_status(path, ec))) {
+        if(!project_files->is_excluded(relative_path, true)) {
+          added_directories.emplace_back(relative_path);
+          project_files->add_files(relative_path, added_files, added_directories);
+        }
+      }
+      else if(boost::filesystem::is_regular_file(boost::filesystem::status(path, ec))) {
+        if(!project_files->is_excluded(relative_path, false))
+          added_files.emplace_back(relative_path);
+      }
+    }
+
+    // Files at or within the updated paths are replaced by the added files
+    auto new_files = std::make_shared<std::vector<boost::filesystem::path>>();
+    new_files->reserve(files->size() + added_files.size());
+    auto files_it = files->begin();
+    for(auto &relative_path : paths) {
+      auto range_begin = std::lower_bound(files_it, files->end(), relative_path);
+      new_files->insert(new_files->end(), files_it, range_begin);
+      files_it = std::find_if(range_begin, files->end(), [&relative_path](const boost::filesystem::path &file) {
+        return !filesystem::file_in_path(file, relative_path);
+      });
+    }
+    new_files->insert(new_files->end(), files_it, files->end());
+    std::sort(added_files.begin(), added_files.end());
+    auto middle = new_files->insert(new_files->end(), added_files.begin(), added_files.end());
+    std::inplace_merge(new_files->begin(), middle, new_files->end());
+    new_files->erase(std::unique(new_files->begin(), new_files->end()), new_files->end());
+
+    if(!added_directories.empty() && project_files->monitored) {
+      project_files->dispatcher.post([project_files, added_directories = std::move(added_directories)] {
+        project_files->add_monitors(added_directories);
+      });
+    }
+
+    lock.lock();
+    project_files->files = std::move(new_files);
+  }
+  project_files->updating = false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "dispatcher.h"
+#include "git.h"
+#include <boost/filesystem.hpp>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+/// Files of a project, listed once in the background and thereafter kept up to date through file monitors.
+/// Files of a directory that is not within a project are listed each time, and are not monitored.
+/// Directories named .git, the build directories and paths ignored by git are not included.
+class ProjectFiles : public std::enable_shared_from_this<ProjectFiles> {
+  ProjectFiles(boost::filesystem::path project_path, std::vector<boost::filesystem::path> exclude_paths, std::shared_ptr<Git::Repository> repository, bool monitored);
+
+public:
+  /// Returns the file list of the project containing path, or of the directory of path if it is not within a project,
+  /// and starts listing the files if needed. Must be called from the main thread.
+  static std::shared_ptr<ProjectFiles> get(const boost::filesystem::path &path);
+
+  const boost::filesystem::path project_path;
+
+  /// Returns the files, relative to project_path, in sorted order. Waits for the files to be listed if needed.
+  std::shared_ptr<const std::vector<boost::filesystem::path>> get_files();
+  /// Returns the files, relative to project_path, in sorted order, or nullptr if the files are being listed
+  std::shared_ptr<const std::vector<boost::filesystem::path>> try_get_files();
+  /// While the files are being listed, calls on_files from the listing thread with the files found so far, and thereafter
+  /// with new files as they are found. These files are not sorted. The listener is removed when the returned object is destroyed.
+  /// Returns nullptr, without calling on_files, if the files are already available through try_get_files().
+  std::shared_ptr<void> add_files_listener(std::function<void(std::shared_ptr<const std::vector<boost::filesystem::path>> files)> on_files);
+
+  /// Adds or removes the given file, or directory and the files within, depending on whether the path exists
+  void update(const boost::filesystem::path &path);
+
+private:
+  /// Relative to project_path
+  const std::vector<boost::filesystem::path> exclude_paths;
+  std::shared_ptr<Git::Repository> repository;
+  /// project_path relative to the work path of repository
+  boost::filesystem::path repository_relative_path;
+  /// False if the files are not kept up to date
+  const bool monitored;
+
+  Dispatcher dispatcher;
+  /// Directory monitors, only used in the main thread
+  std::map<boost::filesystem::path, Glib::RefPtr<Gio::FileMonitor>> monitors;
+
+  std::mutex mutex;
+  std::condition_variable condition_variable;
+  std::shared_ptr<const std::vector<boost::filesystem::path>> files;
+  /// True until the files have been listed
+  bool building = true;
+  /// Files found so far while the files are being listed
+  std::vector<boost::filesystem::path> partial_files;
+  std::map<size_t, std::function<void(std::shared_ptr<const std::vector<boost::filesystem::path>> files)>> files_listeners;
+  size_t files_listener_id = 0;
+  /// Paths, relative to project_path, that are waiting to be updated
+  std::set<boost::filesystem::path> pending_paths;
+  bool updating = false;
+
+  /// Returns true if the file or directory, relative to project_path, is excluded from the file list
+  bool is_excluded(const boost::filesystem::path &relative_path, bool is_directory) const;
+  /// Adds the files in relative_directory and its subdirectories to files, and the subdirectories to directories.
+  /// If set, on_directory_listed is called with files after the files of each directory are added.
+  void add_files(const boost::filesystem::path &relative_directory, std::vector<boost::filesystem::path> &files, std::vector<boost::filesystem::path> &directories,
+                 const std::function<void(const std::vector<boost::filesystem::path> &files)> &on_directory_listed = nullptr) const;
+  void add_monitors(const std::vector<boost::filesystem::path> &relative_directories);
+  /// Removes the monitors of path and its subdirectories
+  void remove_monitors(const boost::filesystem::path &path);
+  static void build(std::shared_ptr<ProjectFiles> project_files);
+  static void update_pending_paths(std::shared_ptr<ProjectFiles> project_files);
+};
@@ -1,15 +1,136 @@
 #include "selection_dialog.h"
 #include <algorithm>
 
-SelectionDialogBase::ListViewText::ListViewText(bool use_markup) : Gtk::TreeView(), use_markup(use_markup) {
-  list_store = Gtk::ListStore::create(column_record);
-  set_model(list_store);
+SelectionDialogBase::ListViewText::RowModel::RowModel(const ColumnRecord &column_record, const std::vector<std::string> &rows)
+    : Glib::ObjectBase(typeid(RowModel)), Glib::Object(), column_record(column_record), rows(rows) {}
+
+Gtk::TreeModelFlags SelectionDialogBase::ListViewText::RowModel::get_flags_vfunc() const {
+  return Gtk::TreeModelFlags::TREE_MODEL_LIST_ONLY;
+}
+
+int SelectionDialogBase::ListViewText::RowModel::get_n_columns_vfunc() const {
+  return column_record.size();
+}
+
+GType SelectionDialogBase::ListViewText::RowModel::get_column_type_vfunc(int index) const {
+  return column_record.types()[index];
+}
+
+void SelectionDialogBase::ListViewText::RowModel::get_value_vfunc(const iterator &iter, int column, Glib::ValueBase &value) const {
+  if(!is_valid(iter))
+    return;
+  auto index = indices[reinterpret_cast<size_t>(iter.gobj()->user_data)];
+  if(column == column_record.text.index()) {
+    Glib::Value<std::string> text;
+    text.init(Glib::Value<std::string>::value_type());
+    text.set(rows[index]);
+    value.init(Glib::Value<std::string>::value_type());
+    value = text;
+  }
+  else if(column == column_record.index.index()) {
+    Glib::Value<unsigned int> index_value;
+    index_value.init(Glib::Value<unsigned int>::value_type());
+    index_value.set(index);
+    value.init(Glib::Value<unsigned int>::value_type());
+    value = index_value;
+  }
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::iter_next_vfunc(const iterator &iter, iterator &iter_next) const {
+  iter_next = iterator();
+  if(!is_valid(iter))
+    return false;
+  auto position = reinterpret_cast<size_t>(iter.gobj()->user_data) + 1;
+  if(position >= indices.size())
+    return false;
+  set_iter(iter_next, position);
+  return true;
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::iter_children_vfunc(const iterator &parent, iterator &iter) const {
+  iter = iterator();
+  return false;
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::iter_has_child_vfunc(const iterator &iter) const {
+  return false;
+}
+
+int SelectionDialogBase::ListViewText::RowModel::iter_n_children_vfunc(const iterator &iter) const {
+  return 0;
+}
+
+int SelectionDialogBase::ListViewText::RowModel::iter_n_root_children_vfunc() const {
+  return indices.size();
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::iter_nth_child_vfunc(const iterator &parent, int n, iterator &iter) const {
+  iter = iterator();
+  return false;
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::iter_nth_root_child_vfunc(int n, iterator &iter) const {
+  iter = iterator();
+  if(n < 0 || static_cast<size_t>(n) >= indices.size())
+    return false;
+  set_iter(iter, n);
+  return true;
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::iter_parent_vfunc(const iterator &child, iterator &iter) const {
+  iter = iterator();
+  return false;
+}
+
+Gtk::TreeModel::Path SelectionDialogBase::ListViewText::RowModel::get_path_vfunc(const iterator &iter) const {
+  Path path;
+  if(is_valid(iter))
+    path.push_back(reinterpret_cast<size_t>(iter.gobj()->user_data));
+  return path;
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::get_iter_vfunc(const Path &path, iterator &iter) const {
+  iter = iterator();
+  if(path.size() != 1 || path[0] < 0 || static_cast<size_t>(path[0]) >= indices.size())
+    return false;
+  set_iter(iter, path[0]);
+  return true;
+}
+
+void SelectionDialogBase::ListViewText::RowModel::append(unsigned int index) {
+  indices.emplace_back(index);
+  Path path;
+  path.push_back(indices.size() - 1);
+  row_inserted(path, get_iter(path));
+}
+
+void SelectionDialogBase::ListViewText::RowModel::invalidate_iters() {
+  ++stamp;
+}
+
+bool SelectionDialogBase::ListViewText::RowModel::is_valid(const iterator &iter) const {
+  return iter.get_stamp() == stamp && reinterpret_cast<size_t>(iter.gobj()->user_data) < indices.size();
+}
+
+void SelectionDialogBase::ListViewText::RowModel::set_iter(iterator &iter, size_t position) const {
+  iter.set_stamp(stamp);
+  iter.gobj()->user_data = reinterpret_cast<void *>(position);
+}
+
+SelectionDialogBase::ListViewText::ListViewText(bool use_markup) : Gtk::TreeView(), use_markup(use_markup), matcher(std::make_shared<FuzzyMatcher>()) {
+  model = RowModel::create(column_record, rows);
+  set_model(model);
   append_column("", cell_renderer);
   if(use_markup)
     get_column(0)->add_attribute(cell_renderer.property_markup(), column_record.text);
   else
     get_column(0)->add_attribute(cell_renderer.property_text(), column_record.text);
 
+  // Rows are given the same height, and the column a fixed width, so that only the shown rows are measured
+  get_column(0)->set_sizing(Gtk::TreeViewColumnSizing::TREE_VIEW_COLUMN_FIXED);
+  get_column(0)->set_fixed_width(column_width);
+  set_fixed_height_mode(true);
+
   get_selection()->set_mode(Gtk::SelectionMode::SELECTION_BROWSE);
   set_enable_search(true);
   set_headers_visible(false);
@@ -19,21 +140,145 @@ SelectionDialogBase::ListViewText::ListViewText(bool use_markup) : Gtk::TreeView
   set_rules_hint(true);
 }
 
+SelectionDialogBase::ListViewText::~ListViewText() {
+  search_key_connection.disconnect();
+  {
+    std::unique_lock<std::mutex> lock(filter_mutex);
+    filter_stop = true;
+  }
+  ++filter_id;
+  filter_condition_variable.notify_one();
+  if(filter_thread.joinable())
+    filter_thread.join();
+  unset_model(); // The model refers to rows
+}
+
 void SelectionDialogBase::ListViewText::append(const std::string &value) {
-  auto new_row = list_store->append();
-  new_row->set_value(column_record.text, value);
-  new_row->set_value(column_record.index, size++);
+  rows.emplace_back(value);
+  if(matcher.use_count() > 1)
+    matcher = std::make_shared<FuzzyMatcher>(*matcher);
+  matcher->add(value, use_markup);
+  if(!model)
+    return;
+  if(search_key.empty()) {
+    model->append(rows.size() - 1);
+    fit_column_width(model->indices.size() - 1);
+  }
+  else if(!search_key_connection.connected()) {
+    // Rows are often appended in batches, and are therefore ranked when idle
+    search_key_connection = Glib::signal_idle().connect([this] {
+      update_rows();
+      return false;
+    });
+  }
 }
 
 void SelectionDialogBase::ListViewText::erase_rows() {
-  list_store->clear();
-  size = 0;
+  search_key_connection.disconnect();
+  ++filter_id;
+  rows.clear();
+  matcher = std::make_shared<FuzzyMatcher>();
+  set_indices({});
 }
 
 void SelectionDialogBase::ListViewText::clear() {
+  search_key_connection.disconnect();
+  ++filter_id;
+  unset_model();
+  model.reset();
+  rows.clear();
+  matcher = std::make_shared<FuzzyMatcher>();
+}
+
+void SelectionDialogBase::ListViewText::set_search_key(const std::string &search_key_) {
+  search_key_connection.disconnect();
+  search_key = search_key_;
+  update_rows();
+}
+
+void SelectionDialogBase::ListViewText::flush_search_key() {
+  if(search_key_connection.connected()) {
+    search_key_connection.disconnect();
+    update_rows(false);
+  }
+}
+
+void SelectionDialogBase::ListViewText::set_indices(std::vector<unsigned int> indices) {
+  if(!model)
+    return;
   unset_model();
-  list_store.reset();
-  size = 0;
+  model->indices = std::move(indices);
+  model->invalidate_iters();
+  set_model(model);
+
+  column_width = 1;
+  for(size_t position = 0; position < model->indices.size() && position < 100; ++position)
+    fit_column_width(position);
+  get_column(0)->set_fixed_width(column_width);
+
+  if(!model->indices.empty())
+    set_cursor(model->get_path(model->children().begin()));
+}
+
+void SelectionDialogBase::ListViewText::fit_column_width(size_t position) {
+  if(position >= 100)
+    return;
+  if(use_markup)
+    cell_renderer.property_markup() = rows[model->indices[position]];
+  else
+    cell_renderer.property_text() = rows[model->indices[position]];
+  int minimum_width, natural_width, horizontal_separator = 0;
+  cell_renderer.get_preferred_width(*this, minimum_width, natural_width);
+  get_style_property("horizontal-separator", horizontal_separator);
+  if(natural_width + horizontal_separator > column_width) {
+    column_width = natural_width + horizontal_separator;
+    get_column(0)->set_fixed_width(column_width);
+  }
+}
+
+void SelectionDialogBase::ListViewText::update_rows(bool use_filter_thread) {
+  if(!model)
+    return;
+  auto id = ++filter_id;
+  if(!use_filter_thread || search_key.empty() || matcher->size() < min_filter_thread_rows) {
+    set_indices(matcher->find(search_key, search_key.empty() ? std::numeric_limits<size_t>::max() : max_matches));
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(filter_mutex);
+    filter_matcher = matcher;
+    filter_search_key = search_key;
+    filter_matcher_id = id;
+  }
+  if(!filter_thread.joinable()) {
+    filter_thread = std::thread([this] {
+      std::unique_lock<std::mutex> lock(filter_mutex);
+      while(true) {
+        filter_condition_variable.wait(lock, [this] { return filter_matcher || filter_stop; });
+        if(filter_stop)
+          return;
+        auto snapshot = std::move(filter_matcher);
+        auto key = std::move(filter_search_key);
+        auto id = filter_matcher_id;
+        lock.unlock();
+
+        auto indices = snapshot->find(key, max_matches, [this, id] {
+          return filter_id != id;
+        });
+        snapshot = nullptr; // Rows can again be added without copying the matcher
+        if(filter_id == id) {
+          dispatcher.post([this, id, indices = std::move(indices)]() mutable {
+            if(filter_id == id)
+              set_indices(std::move(indices));
+          });
+        }
+
+        lock.lock();
+      }
+    });
+  }
+  filter_condition_variable.notify_one();
 }
 
 SelectionDialogBase::SelectionDialogBase(Gtk::TextView *text_view, const Glib::RefPtr<Gtk::TextBuffer::Mark> &start_mark, bool show_search_entry, bool use_markup)
@@ -155,6 +400,7 @@ void SelectionDialogBase::erase_rows() {
 }
 
 void SelectionDialogBase::show() {
+  list_view_text.flush_search_key();
   window.show_all();
   if(text_view)
     text_view->grab_focus();
@@ -197,42 +443,13 @@ std::unique_ptr<SelectionDialog> SelectionDialog::instance;
 
 SelectionDialog::SelectionDialog(Gtk::TextView *text_view, const Glib::RefPtr<Gtk::TextBuffer::Mark> &start_mark, bool show_search_entry, bool use_markup)
     : SelectionDialogBase(text_view, start_mark, show_search_entry, use_markup) {
-  auto search_key = std::make_shared<std::string>();
-  auto filter_model = Gtk::TreeModelFilter::create(list_view_text.get_model());
-
-  filter_model->set_visible_func([this, search_key](const Gtk::TreeModel::const_iterator &iter) {
-    std::string row_lc;
-    iter->get_value(0, row_lc);
-    auto search_key_lc = *search_key;
-    std::transform(row_lc.begin(), row_lc.end(), row_lc.begin(), ::tolower);
-    std::transform(search_key_lc.begin(), search_key_lc.end(), search_key_lc.begin(), ::tolower);
-    if(list_view_text.use_markup) {
-      size_t pos = 0;
-      while((pos = row_lc.find('<', pos)) != std::string::npos) {
-        auto pos2 = row_lc.find('>', pos + 1);
-        row_lc.erase(pos, pos2 - pos + 1);
-      }
-      search_key_lc = Glib::Markup::escape_text(search_key_lc);
-    }
-    if(row_lc.find(search_key_lc) != std::string::npos)
-      return true;
-    return false;
-  });
-
-  list_view_text.set_model(filter_model);
-
   list_view_text.set_search_equal_func([](const Glib::RefPtr<Gtk::TreeModel> &model, int column, const Glib::ustring &key, const Gtk::TreeModel::iterator &iter) {
     return false;
   });
 
-  search_entry.signal_changed().connect([this, search_key, filter_model]() {
-    *search_key = search_entry.get_text();
-    filter_model->refilter();
+  search_entry.signal_changed().connect([this]() {
+    list_view_text.set_search_key(search_entry.get_text());
     list_view_text.set_search_entry(search_entry); //TODO:Report the need of this to GTK's git (bug)
-    if(search_key->empty()) {
-      if(list_view_text.get_model()->children().size() > 0)
-        list_view_text.set_cursor(list_view_text.get_model()->get_path(list_view_text.get_model()->children().begin()));
-    }
   });
 
   auto activate = [this]() {
@@ -328,33 +545,8 @@ std::unique_ptr<CompletionDialog> CompletionDialog::instance;
 CompletionDialog::CompletionDialog(Gtk::TextView *text_view, const Glib::RefPtr<Gtk::TextBuffer::Mark> &start_mark) : SelectionDialogBase(text_view, start_mark, false, false) {
   show_offset = text_view->get_buffer()->get_insert()->get_iter().get_offset();
 
-  auto search_key = std::make_shared<std::string>();
-  auto filter_model = Gtk::TreeModelFilter::create(list_view_text.get_model());
-  if(show_offset == start_mark->get_iter().get_offset()) {
-    filter_model->set_visible_func([search_key](const Gtk::TreeModel::const_iterator &iter) {
-      std::string row_lc;
-      iter->get_value(0, row_lc);
-      auto search_key_lc = *search_key;
-      std::transform(row_lc.begin(), row_lc.end(), row_lc.begin(), ::tolower);
-      std::transform(search_key_lc.begin(), search_key_lc.end(), search_key_lc.begin(), ::tolower);
-      if(row_lc.find(search_key_lc) != std::string::npos)
-        return true;
-      return false;
-    });
-  }
-  else {
-    filter_model->set_visible_func([search_key](const Gtk::TreeModel::const_iterator &iter) {
-      std::string row;
-      iter->get_value(0, row);
-      if(row.find(*search_key) == 0)
-        return true;
-      return false;
-    });
-  }
-  list_view_text.set_model(filter_model);
-  search_entry.signal_changed().connect([this, search_key, filter_model]() {
-    *search_key = search_entry.get_text();
-    filter_model->refilter();
+  search_entry.signal_changed().connect([this]() {
+    list_view_text.set_search_key(search_entry.get_text());
     list_view_text.set_search_entry(search_entry); //TODO:Report the need of this to GTK's git (bug)
   });
 
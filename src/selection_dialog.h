@@ -1,6 +1,12 @@
 #pragma once
+#include "dispatcher.h"
+#include "fuzzy_match.h"
 #include "gtkmm.h"
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 class SelectionDialogBase {
@@ -15,18 +21,95 @@ class SelectionDialogBase {
       Gtk::TreeModelColumn<unsigned int> index;
     };
 
+    /// List model of the rows at the given indices of a row vector. The rows are not copied into the model,
+    /// and GTK only reads the rows it shows.
+    class RowModel : public Glib::Object, public Gtk::TreeModel {
+    protected:
+      RowModel(const ColumnRecord &column_record, const std::vector<std::string> &rows);
+
+      Gtk::TreeModelFlags get_flags_vfunc() const override;
+      int get_n_columns_vfunc() const override;
+      GType get_column_type_vfunc(int index) const override;
+      void get_value_vfunc(const iterator &iter, int column, Glib::ValueBase &value) const override;
+      bool iter_next_vfunc(const iterator &iter, iterator &iter_next) const override;
+      bool iter_children_vfunc(const iterator &parent, iterator &iter) const override;
+      bool iter_has_child_vfunc(const iterator &iter) const override;
+      int iter_n_children_vfunc(const iterator &iter) const override;
+      int iter_n_root_children_vfunc() const override;
+      bool iter_nth_child_vfunc(const iterator &parent, int n, iterator &iter) const override;
+      bool iter_nth_root_child_vfunc(int n, iterator &iter) const override;
+      bool iter_parent_vfunc(const iterator &child, iterator &iter) const override;
+      Path get_path_vfunc(const iterator &iter) const override;
+      bool get_iter_vfunc(const Path &path, iterator &iter) const override;
+
+    public:
+      static Glib::RefPtr<RowModel> create(const ColumnRecord &column_record, const std::vector<std::string> &rows) {
+        return Glib::RefPtr<RowModel>(new RowModel(column_record, rows));
+      }
+
+      /// Indices of the shown rows. Views of the model must be unset while the indices are replaced.
+      std::vector<unsigned int> indices;
+      /// Shows the row at index as the last row
+      void append(unsigned int index);
+      /// Invalidates iterators after the indices are replaced
+      void invalidate_iters();
+
+    private:
+      const ColumnRecord &column_record;
+      const std::vector<std::string> &rows;
+      int stamp = 1;
+
+      bool is_valid(const iterator &iter) const;
+      void set_iter(iterator &iter, size_t position) const;
+    };
+
   public:
     bool use_markup;
     ColumnRecord column_record;
     ListViewText(bool use_markup);
+    ~ListViewText() override;
     void append(const std::string &value);
     void erase_rows();
     void clear();
 
+    /// Shows the rows matching search_key, best matches first, or all rows in their original order if search_key is empty.
+    /// Large row lists are filtered in a worker thread, and the rows shown are replaced when the filter is done.
+    void set_search_key(const std::string &search_key);
+    /// Applies a search key to rows appended since the search key was set, without using the worker thread
+    void flush_search_key();
+
+    /// Maximum number of rows shown when a search key is set
+    static const size_t max_matches = 10000;
+    /// Rows are filtered in the worker thread if there are at least this many rows
+    static const size_t min_filter_thread_rows = 10000;
+
   private:
-    Glib::RefPtr<Gtk::ListStore> list_store;
+    Glib::RefPtr<RowModel> model;
     Gtk::CellRendererText cell_renderer;
-    unsigned int size = 0;
+    std::vector<std::string> rows;
+    /// Copied before rows are added if the worker thread still uses it
+    std::shared_ptr<FuzzyMatcher> matcher;
+    std::string search_key;
+    sigc::connection search_key_connection;
+    int column_width = 1;
+
+    Dispatcher dispatcher;
+    std::thread filter_thread;
+    std::mutex filter_mutex;
+    std::condition_variable filter_condition_variable;
+    /// Incremented for each filter, which cancels earlier filters in progress
+    std::atomic<size_t> filter_id = {0};
+    /// Next filter of the worker thread, protected by filter_mutex
+    std::shared_ptr<const FuzzyMatcher> filter_matcher;
+    std::string filter_search_key;
+    size_t filter_matcher_id;
+    bool filter_stop = false;
+
+    /// Shows the rows at indices, and selects the first row
+    void set_indices(std::vector<unsigned int> indices);
+    /// Widens the column to fit the row at position, if the row is one of the first rows shown
+    void fit_column_width(size_t position);
+    void update_rows(bool use_filter_thread = true);
   };
 
   class SearchEntry : public Gtk::Entry {
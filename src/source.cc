@@ -968,12 +968,12 @@ void Source::View::insert_with_links_tagged(const Glib::RefPtr<Gtk::TextBuffer>
   buffer->insert(buffer->get_insert()->get_iter(), &text[start_pos], &text[text.size()]);
 }
 
-void Source::View::add_diagnostic_tooltip(const Gtk::TextIter &start, const Gtk::TextIter &end, bool error, std::function<void(const Glib::RefPtr<Gtk::TextBuffer> &)> &&set_buffer) {
+Tooltips::iterator Source::View::add_diagnostic_tooltip(const Gtk::TextIter &start, const Gtk::TextIter &end, bool error, std::function<void(const Glib::RefPtr<Gtk::TextBuffer> &)> &&set_buffer) {
   diagnostic_offsets.emplace(start.get_offset());
 
   std::string severity_tag_name = error ? "def:error" : "def:warning";
 
-  diagnostic_tooltips.emplace_back(this, get_buffer()->create_mark(start), get_buffer()->create_mark(end), [error, severity_tag_name, set_buffer = std::move(set_buffer)](const Glib::RefPtr<Gtk::TextBuffer> &buffer) {
+  auto tooltip = diagnostic_tooltips.emplace_back(this, get_buffer()->create_mark(start), get_buffer()->create_mark(end), [error, severity_tag_name, set_buffer = std::move(set_buffer)](const Glib::RefPtr<Gtk::TextBuffer> &buffer) {
     buffer->insert_with_tag(buffer->get_insert()->get_iter(), error ? "Error" : "Warning", severity_tag_name);
     buffer->insert(buffer->get_insert()->get_iter(), ":\n");
     set_buffer(buffer);
@@ -987,6 +987,7 @@ void Source::View::add_diagnostic_tooltip(const Gtk::TextIter &start, const Gtk:
     if(next_iter.forward_char())
       get_buffer()->remove_tag_by_name(severity_tag_name + "_underline", iter, next_iter);
   }
+  return tooltip;
 }
 
 void Source::View::clear_diagnostic_tooltips() {
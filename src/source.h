@@ -32,6 +32,7 @@ namespace Source {
     bool operator==(const Offset &o) { return (line == o.line && index == o.index); }
 
     unsigned line;
+    /// Byte index in the line
     unsigned index;
     boost::filesystem::path file_path;
   };
@@ -105,7 +106,7 @@ namespace Source {
     void insert_with_links_tagged(const Glib::RefPtr<Gtk::TextBuffer> &buffer, const std::string &text);
 
     virtual void show_diagnostic_tooltips(const Gdk::Rectangle &rectangle) { diagnostic_tooltips.show(rectangle); }
-    void add_diagnostic_tooltip(const Gtk::TextIter &start, const Gtk::TextIter &end, bool error, std::function<void(const Glib::RefPtr<Gtk::TextBuffer> &)> &&set_buffer);
+    Tooltips::iterator add_diagnostic_tooltip(const Gtk::TextIter &start, const Gtk::TextIter &end, bool error, std::function<void(const Glib::RefPtr<Gtk::TextBuffer> &)> &&set_buffer);
     void clear_diagnostic_tooltips();
     std::set<int> diagnostic_offsets;
     void place_cursor_at_next_diagnostic();
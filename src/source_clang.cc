@@ -11,6 +11,7 @@
 #include "documentation_cppreference.h"
 #include "filesystem.h"
 #include "info.h"
+#include "notebook.h"
 #include "selection_dialog.h"
 #include "usages_clang.h"
 
@@ -55,9 +56,11 @@ bool Source::ClangViewParse::save() {
     return false;
 
   if(language->get_id() == "chdr" || language->get_id() == "cpphdr") {
+    auto path = filesystem::get_normal_path(file_path).string();
     for(auto &view : views) {
       if(auto clang_view = dynamic_cast<Source::ClangView *>(view)) {
-        if(this != clang_view)
+        // Views that have not yet been fully parsed are always reparsed, since their inclusions are unknown
+        if(this != clang_view && (!clang_view->inclusions_parsed || clang_view->inclusions.count(path) > 0))
           clang_view->soft_reparse_needed = true;
       }
     }
@@ -93,6 +96,8 @@ void Source::ClangViewParse::configure() {
 void Source::ClangViewParse::parse_initialize() {
   hide_tooltips();
   parsed = false;
+  inclusions_parsed = false;
+  inclusions.clear();
   if(parse_thread.joinable())
     parse_thread.join();
   parse_state = ParseState::PROCESSING;
@@ -119,6 +124,18 @@ void Source::ClangViewParse::parse_initialize() {
   if(build->project_path.empty())
     Info::get().print(file_path.filename().string() + ": could not find a supported build system");
   build->update_default();
+  // Headers without a source file that includes them get fallback arguments until the include index is built, and are then parsed again
+  header_commands_listener = nullptr;
+  if(CompileCommands::is_header(file_path)) {
+    header_commands_listener = CompileCommands::add_header_commands_listener(build->get_default_path(), [this] {
+      dispatcher.post([this] {
+        header_commands_listener = nullptr;
+        full_reparse_needed = true;
+        if(Notebook::get().get_current_view() == this)
+          full_reparse();
+      });
+    });
+  }
   auto arguments = CompileCommands::get_arguments(build->get_default_path(), file_path);
   clang_tu = std::make_unique<clangmm::TranslationUnit>(clang_index, file_path.string(), arguments, buffer_raw);
   clang_tokens = clang_tu->get_tokens();
@@ -166,6 +183,7 @@ void Source::ClangViewParse::parse_initialize() {
             for(auto &token : *clang_tokens)
               clang_tokens_offsets.emplace_back(token.get_source_range().get_offsets());
             clang_diagnostics = clang_tu->get_diagnostics();
+            clang_inclusions = get_inclusions();
             parse_lock.unlock();
             dispatcher.post([this] {
               std::unique_lock<std::mutex> parse_lock(parse_mutex, std::defer_lock);
@@ -174,6 +192,8 @@ void Source::ClangViewParse::parse_initialize() {
                 if(parse_process_state.compare_exchange_strong(expected, ParseProcessState::IDLE)) {
                   update_syntax();
                   update_diagnostics();
+                  inclusions = std::move(clang_inclusions);
+                  inclusions_parsed = true;
                   parsed = true;
                   status_state = "";
                   if(update_status_state)
@@ -204,6 +224,17 @@ void Source::ClangViewParse::parse_initialize() {
   });
 }
 
+std::unordered_set<std::string> Source::ClangViewParse::get_inclusions() {
+  std::unordered_set<std::string> inclusions;
+  // Includes both direct and transitive inclusions of the translation unit
+  clang_getInclusions(clang_tu->cx_tu, [](CXFile included_file, CXSourceLocation *inclusion_stack, unsigned include_len, CXClientData data) {
+    auto inclusions = static_cast<std::unordered_set<std::string> *>(data);
+    if(include_len > 0)
+      inclusions->emplace(filesystem::get_normal_path(clangmm::to_string(clang_getFileName(included_file))).string());
+  }, &inclusions);
+  return inclusions;
+}
+
 void Source::ClangViewParse::soft_reparse(bool delayed) {
   soft_reparse_needed = false;
   parsed = false;
@@ -1768,6 +1799,7 @@ void Source::ClangView::full_reparse() {
 
 void Source::ClangView::async_delete() {
   delayed_show_arguments_connection.disconnect();
+  header_commands_listener = nullptr;
 
   views.erase(this);
   std::set<boost::filesystem::path> project_paths_in_use;
@@ -9,6 +9,7 @@
 #include <mutex>
 #include <set>
 #include <thread>
+#include <unordered_set>
 
 namespace Source {
   class ClangViewParse : public View {
@@ -27,6 +28,8 @@ namespace Source {
 
   protected:
     Dispatcher dispatcher;
+    /// Set while a header is parsed with fallback arguments, since the include index of the compile commands is still being built
+    std::shared_ptr<void> header_commands_listener;
     void parse_initialize();
     std::unique_ptr<clangmm::TranslationUnit> clang_tu;
     std::unique_ptr<clangmm::Tokens> clang_tokens;
@@ -54,6 +57,14 @@ namespace Source {
     void update_diagnostics();
     std::vector<clangmm::Diagnostic> clang_diagnostics;
 
+    /// Returns the normalized paths of the files included, directly or indirectly, in clang_tu
+    std::unordered_set<std::string> get_inclusions();
+    /// Set in parse thread, and moved to inclusions on successful parse
+    std::unordered_set<std::string> clang_inclusions;
+    /// Used to only reparse views that include a saved header file
+    std::unordered_set<std::string> inclusions;
+    bool inclusions_parsed = false;
+
     static clangmm::Index clang_index;
   };
 
@@ -1,6 +1,7 @@
 #include "source_language_protocol.h"
 #include "filesystem.h"
 #include "info.h"
+#include "json.h"
 #include "notebook.h"
 #include "project.h"
 #include "selection_dialog.h"
@@ -10,6 +11,7 @@
 #endif
 #include "config.h"
 #include "menu.h"
+#include <algorithm>
 #include <future>
 #include <limits>
 #include <regex>
@@ -40,16 +42,225 @@ LanguageProtocol::Diagnostic::Diagnostic(const boost::property_tree::ptree &pt)
 
 LanguageProtocol::TextEdit::TextEdit(const boost::property_tree::ptree &pt, std::string new_text_) : range(pt.get_child("range")), new_text(new_text_.empty() ? pt.get<std::string>("newText") : std::move(new_text_)) {}
 
+LanguageProtocol::SemanticTokens::Edit::Edit(const boost::property_tree::ptree &pt) : start(pt.get<size_t>("start")), delete_count(pt.get<size_t>("deleteCount")), data(read_data(pt.get_child("data", boost::property_tree::ptree()))) {}
+
+std::vector<int> LanguageProtocol::SemanticTokens::read_data(const boost::property_tree::ptree &pt) {
+  std::vector<int> data;
+  data.reserve(pt.size());
+  for(auto it = pt.begin(); it != pt.end(); ++it)
+    data.emplace_back(it->second.get_value<int>(0));
+  return data;
+}
+
+void LanguageProtocol::SemanticTokens::set(std::vector<int> &&data_) {
+  data = std::move(data_);
+  decode();
+}
+
+std::pair<size_t, size_t> LanguageProtocol::SemanticTokens::apply(std::vector<Edit> &&edits) {
+  if(edits.empty())
+    return {0, 0};
+
+  // Apply the edits from the back so that the start indices remain valid
+  std::sort(edits.begin(), edits.end(), [](const Edit &a, const Edit &b) {
+    return a.start > b.start;
+  });
+  size_t first = data.size(), unchanged_suffix = data.size();
+  for(auto &edit : edits) {
+    if(edit.start > data.size() || edit.delete_count > data.size() - edit.start)
+      throw std::out_of_range("semantic tokens edit outside of data");
+    first = std::min(first, edit.start);
+    unchanged_suffix = std::min(unchanged_suffix, data.size() - edit.start - edit.delete_count);
+    data.erase(data.begin() + edit.start, data.begin() + edit.start + edit.delete_count);
+    data.insert(data.begin() + edit.start, edit.data.begin(), edit.data.end());
+  }
+  decode();
+
+  return {std::min(first / 5, tokens.size()), std::min((data.size() - unchanged_suffix + 4) / 5, tokens.size())};
+}
+
+void LanguageProtocol::SemanticTokens::decode() {
+  tokens.clear();
+  tokens.reserve(data.size() / 5);
+  int line = 0, character = 0;
+  for(size_t c = 0; c + 5 <= data.size(); c += 5) {
+    if(data[c] != 0) {
+      line += data[c];
+      character = data[c + 1];
+    }
+    else
+      character += data[c + 1];
+    tokens.emplace_back(Token{line, character, data[c + 2], data[c + 3]});
+  }
+}
+
+void LanguageProtocol::CompletionItems::clear() {
+  labels.clear();
+  inserts.clear();
+  comments.clear();
+  resolve_data.clear();
+  buffer.clear();
+}
+
+void LanguageProtocol::CompletionItems::emplace_back(const std::string &label, const std::string &insert, const std::string &comment, const std::string &data) {
+  labels.emplace_back(add(label));
+  inserts.emplace_back(add(insert));
+  comments.emplace_back(add(comment));
+  resolve_data.emplace_back(add(data));
+}
+
+std::string LanguageProtocol::CompletionItems::get_resolve_params(size_t index) const {
+  auto label = get(labels[index]);
+  Source::LanguageProtocolView::escape_text(label);
+  return R"("label":")" + label + R"(","data":)" + get(resolve_data[index]);
+}
+
+LanguageProtocol::CompletionItems::String LanguageProtocol::CompletionItems::add(const std::string &string) {
+  String result{buffer.size(), string.size()};
+  buffer += string;
+  return result;
+}
+
+void LanguageProtocol::Utf16Index::reset(int line_count) {
+  lines.clear();
+  lines.resize(line_count);
+}
+
+void LanguageProtocol::Utf16Index::insert(int line, int new_lines) {
+  if(line < 0 || line >= get_line_count())
+    return;
+  lines[line].indexed = false;
+  lines.insert(lines.begin() + line + 1, std::max(new_lines, 0), Line());
+}
+
+void LanguageProtocol::Utf16Index::erase(int line, int removed_lines) {
+  if(line < 0 || line >= get_line_count())
+    return;
+  lines[line].indexed = false;
+  removed_lines = std::max(std::min(removed_lines, get_line_count() - line - 1), 0);
+  lines.erase(lines.begin() + line + 1, lines.begin() + line + 1 + removed_lines);
+}
+
+int LanguageProtocol::Utf16Index::get_offset(int line, int utf16_pos, const std::function<std::string(int line)> &get_line_text) {
+  if(line < 0 || line >= get_line_count())
+    return utf16_pos;
+  auto &surrogate_pair_offsets = get_surrogate_pair_offsets(line, get_line_text);
+  int offset = utf16_pos;
+  for(size_t c = 0; c < surrogate_pair_offsets.size(); ++c) {
+    // UTF-16 position of the character is its offset plus the number of preceding surrogate pairs
+    if(utf16_pos <= surrogate_pair_offsets[c] + static_cast<int>(c))
+      break;
+    --offset;
+  }
+  return offset;
+}
+
+int LanguageProtocol::Utf16Index::get_utf16_pos(int line, int offset, const std::function<std::string(int line)> &get_line_text) {
+  if(line < 0 || line >= get_line_count())
+    return offset;
+  auto &surrogate_pair_offsets = get_surrogate_pair_offsets(line, get_line_text);
+  return offset + static_cast<int>(std::lower_bound(surrogate_pair_offsets.begin(), surrogate_pair_offsets.end(), offset) - surrogate_pair_offsets.begin());
+}
+
+int LanguageProtocol::Utf16Index::get_line_index(const std::string &line, int utf16_pos) {
+  int pos = 0;
+  size_t index = 0;
+  while(index < line.size() && pos < utf16_pos) {
+    auto byte = static_cast<unsigned char>(line[index]);
+    pos += byte >= 0xF0 ? 2 : 1; // Four byte UTF-8 sequences are two UTF-16 code units
+    ++index;
+    while(index < line.size() && (static_cast<unsigned char>(line[index]) & 0xC0) == 0x80) // UTF-8 continuation byte
+      ++index;
+  }
+  return static_cast<int>(index);
+}
+
+const std::vector<int> &LanguageProtocol::Utf16Index::get_surrogate_pair_offsets(int line, const std::function<std::string(int line)> &get_line_text) {
+  auto &line_index = lines[line];
+  if(!line_index.indexed) {
+    line_index.surrogate_pair_offsets.clear();
+    auto text = get_line_text(line);
+    int offset = 0;
+    for(auto chr : text) {
+      auto byte = static_cast<unsigned char>(chr);
+      if((byte & 0xC0) == 0x80) // UTF-8 continuation byte
+        continue;
+      if(byte >= 0xF0) // Four byte UTF-8 sequences are outside of the Basic Multilingual Plane
+        line_index.surrogate_pair_offsets.emplace_back(offset);
+      ++offset;
+    }
+    line_index.indexed = true;
+  }
+  return line_index.surrogate_pair_offsets;
+}
+
 LanguageProtocol::Client::Client(std::string root_uri_, std::string language_id_) : root_uri(std::move(root_uri_)), language_id(std::move(language_id_)) {
+  if(!Config::get().log.language_server_record_path.empty()) {
+    auto path = filesystem::get_long_path(Config::get().log.language_server_record_path);
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(path, ec);
+    // Clients of other projects, or of other juCi instances, can be started in the same second
+    auto name = language_id + '_' + std::to_string(std::time(nullptr)) + '_' + std::to_string(std::hash<std::string>()(root_uri));
+    auto record_path = path / (name + ".record");
+    for(size_t c = 2; boost::filesystem::exists(record_path, ec); ++c)
+      record_path = path / (name + '_' + std::to_string(c) + ".record");
+    path = std::move(record_path);
+    record_stream = std::make_unique<std::ofstream>(path.string(), std::ofstream::binary);
+    if(*record_stream)
+      record_start_time = std::chrono::steady_clock::now();
+    else {
+      std::cerr << "Error: could not open language server record file " << path.string() << std::endl;
+      record_stream = nullptr;
+    }
+  }
+
   process = std::make_unique<TinyProcessLib::Process>(language_id + "-language-server", root_uri, [this](const char *bytes, size_t n) {
-    server_message_stream.write(bytes, n);
-    parse_server_message();
+    if(record_stream)
+      record('<', bytes, n);
+    message_framer.write(bytes, n, [this](const char *content, size_t size) {
+      parse_server_message(content, size);
+    });
   }, [](const char *bytes, size_t n) {
     std::cerr.write(bytes, n);
   }, true, 1048576);
+
+  timeout_thread = std::thread([this] {
+    std::unique_lock<std::mutex> lock(timeouts_mutex);
+    while(!timeouts_stop) {
+      if(timeouts.empty()) {
+        timeouts_condition_variable.wait(lock);
+        continue;
+      }
+      auto deadline = timeouts.front().first;
+      if(std::chrono::steady_clock::now() < deadline) {
+        timeouts_condition_variable.wait_until(lock, deadline);
+        continue;
+      }
+      auto message_id = timeouts.front().second;
+      timeouts.pop();
+      lock.unlock();
+      {
+        std::unique_lock<std::mutex> lock(read_write_mutex);
+        cancelled_ids.erase(message_id);
+        auto id_it = handlers.find(message_id);
+        if(id_it != handlers.end()) {
+          Terminal::get().async_print("Request to language server timed out. If you suspect the server has crashed, please close and reopen all project source files.\n", true);
+          auto function = std::move(id_it->second.second);
+          handlers.erase(id_it->first);
+          lock.unlock();
+          function(boost::property_tree::ptree(), true);
+        }
+      }
+      lock.lock();
+    }
+  });
 }
 
 std::shared_ptr<LanguageProtocol::Client> LanguageProtocol::Client::get(const boost::filesystem::path &file_path, const std::string &language_id) {
+  return get(file_path, language_id, true);
+}
+
+std::shared_ptr<LanguageProtocol::Client> LanguageProtocol::Client::get(const boost::filesystem::path &file_path, const std::string &language_id, bool create) {
   std::string root_uri;
   auto build = Project::Build::create(file_path);
   if(!build->project_path.empty())
@@ -63,10 +274,13 @@ std::shared_ptr<LanguageProtocol::Client> LanguageProtocol::Client::get(const bo
   static std::mutex mutex;
   std::lock_guard<std::mutex> lock(mutex);
   auto it = cache.find(cache_id);
-  if(it == cache.end())
+  if(it == cache.end()) {
+    if(!create)
+      return nullptr;
     it = cache.emplace(cache_id, std::weak_ptr<Client>()).first;
+  }
   auto instance = it->second.lock();
-  if(!instance)
+  if(!instance && create)
     it->second = instance = std::shared_ptr<Client>(new Client(root_uri, language_id), [](Client *client_ptr) {
       std::thread delete_thread([client_ptr] {
         delete client_ptr;
@@ -76,6 +290,29 @@ std::shared_ptr<LanguageProtocol::Client> LanguageProtocol::Client::get(const bo
   return instance;
 }
 
+void LanguageProtocol::Client::prestart(const boost::filesystem::path &path, const std::string &language_id) {
+  if(!Config::get().source.language_server_prestart || Config::get().source.language_server_grace_period == 0)
+    return;
+  if(filesystem::find_executable(language_id + "-language-server").empty())
+    return;
+  if(get(path, language_id, false)) // The language server is already running
+    return;
+
+  auto client = get(path, language_id);
+  keep_alive(client);
+  std::thread initialize_thread([client = std::move(client)] {
+    client->initialize(nullptr);
+  });
+  initialize_thread.detach();
+}
+
+void LanguageProtocol::Client::keep_alive(std::shared_ptr<Client> client) {
+  auto grace_period = Config::get().source.language_server_grace_period;
+  if(grace_period == 0)
+    return;
+  Glib::signal_timeout().connect_seconds_once([client = std::move(client)] {}, grace_period);
+}
+
 LanguageProtocol::Client::~Client() {
   std::promise<void> result_processed;
   write_request(nullptr, "shutdown", "", [this, &result_processed](const boost::property_tree::ptree &result, bool error) {
@@ -85,9 +322,12 @@ LanguageProtocol::Client::~Client() {
   });
   result_processed.get_future().get();
 
-  std::unique_lock<std::mutex> lock(timeout_threads_mutex);
-  for(auto &thread : timeout_threads)
-    thread.join();
+  {
+    std::unique_lock<std::mutex> lock(timeouts_mutex);
+    timeouts_stop = true;
+  }
+  timeouts_condition_variable.notify_one();
+  timeout_thread.join();
 
   int exit_status = -1;
   for(size_t c = 0; c < 20; ++c) {
@@ -113,13 +353,20 @@ LanguageProtocol::Capabilities LanguageProtocol::Client::initialize(Source::Lang
     return capabilities;
 
   std::promise<void> result_processed;
-  write_request(nullptr, "initialize", "\"processId\":" + std::to_string(process->get_id()) + R"(,"rootUri":"file://)" + root_uri + R"(","capabilities":{"workspace":{"didChangeConfiguration":{"dynamicRegistration":true},"didChangeWatchedFiles":{"dynamicRegistration":true},"symbol":{"dynamicRegistration":true},"executeCommand":{"dynamicRegistration":true}},"textDocument":{"synchronization":{"dynamicRegistration":true,"willSave":true,"willSaveWaitUntil":true,"didSave":true},"completion":{"dynamicRegistration":true,"completionItem":{"snippetSupport":true}},"hover":{"dynamicRegistration":true},"signatureHelp":{"dynamicRegistration":true},"definition":{"dynamicRegistration":true},"references":{"dynamicRegistration":true},"documentHighlight":{"dynamicRegistration":true},"documentSymbol":{"dynamicRegistration":true},"codeAction":{"dynamicRegistration":true},"codeLens":{"dynamicRegistration":true},"formatting":{"dynamicRegistration":true},"rangeFormatting":{"dynamicRegistration":true},"onTypeFormatting":{"dynamicRegistration":true},"rename":{"dynamicRegistration":true},"documentLink":{"dynamicRegistration":true}}},"initializationOptions":{"omitInitBuild":true},"trace":"off")", [this, &result_processed](const boost::property_tree::ptree &result, bool error) {
+  write_request(nullptr, "initialize", "\"processId\":" + std::to_string(process->get_id()) + R"(,"rootUri":"file://)" + root_uri + R"(","capabilities":{"workspace":{"didChangeConfiguration":{"dynamicRegistration":true},"didChangeWatchedFiles":{"dynamicRegistration":true},"symbol":{"dynamicRegistration":true},"executeCommand":{"dynamicRegistration":true}},"textDocument":{"synchronization":{"dynamicRegistration":true,"willSave":true,"willSaveWaitUntil":true,"didSave":true},"completion":{"dynamicRegistration":true,"completionItem":{"snippetSupport":true,"resolveSupport":{"properties":["detail","documentation"]}}},"hover":{"dynamicRegistration":true},"signatureHelp":{"dynamicRegistration":true},"definition":{"dynamicRegistration":true},"references":{"dynamicRegistration":true},"documentHighlight":{"dynamicRegistration":true},"documentSymbol":{"dynamicRegistration":true},"codeAction":{"dynamicRegistration":true},"codeLens":{"dynamicRegistration":true},"formatting":{"dynamicRegistration":true},"rangeFormatting":{"dynamicRegistration":true},"onTypeFormatting":{"dynamicRegistration":true},"rename":{"dynamicRegistration":true},"documentLink":{"dynamicRegistration":true},"semanticTokens":{"dynamicRegistration":false,"requests":{"full":{"delta":true}},"tokenTypes":["namespace","type","class","enum","interface","struct","typeParameter","parameter","variable","property","enumMember","function","method","macro","keyword","comment","string","number"],"tokenModifiers":[],"formats":["relative"]}}},"initializationOptions":{"omitInitBuild":true},"trace":"off")", [this, &result_processed](const boost::property_tree::ptree &result, bool error) {
     if(!error) {
       auto capabilities_pt = result.find("capabilities");
       if(capabilities_pt != result.not_found()) {
-        capabilities.text_document_sync = static_cast<LanguageProtocol::Capabilities::TextDocumentSync>(capabilities_pt->second.get<int>("textDocumentSync", 0));
+        auto text_document_sync_it = capabilities_pt->second.find("textDocumentSync");
+        if(text_document_sync_it != capabilities_pt->second.not_found()) {
+          if(text_document_sync_it->second.empty())
+            capabilities.text_document_sync = static_cast<LanguageProtocol::Capabilities::TextDocumentSync>(text_document_sync_it->second.get_value<int>(0));
+          else // TextDocumentSyncOptions
+            capabilities.text_document_sync = static_cast<LanguageProtocol::Capabilities::TextDocumentSync>(text_document_sync_it->second.get<int>("change", 0));
+        }
         capabilities.hover = capabilities_pt->second.get<bool>("hoverProvider", false);
         capabilities.completion = capabilities_pt->second.find("completionProvider") != capabilities_pt->second.not_found() ? true : false;
+        capabilities.completion_resolve = capabilities_pt->second.get<bool>("completionProvider.resolveProvider", false);
         capabilities.signature_help = capabilities_pt->second.find("signatureHelpProvider") != capabilities_pt->second.not_found() ? true : false;
         capabilities.definition = capabilities_pt->second.get<bool>("definitionProvider", false);
         capabilities.references = capabilities_pt->second.get<bool>("referencesProvider", false);
@@ -129,6 +376,15 @@ LanguageProtocol::Capabilities LanguageProtocol::Client::initialize(Source::Lang
         capabilities.document_formatting = capabilities_pt->second.get<bool>("documentFormattingProvider", false);
         capabilities.document_range_formatting = capabilities_pt->second.get<bool>("documentRangeFormattingProvider", false);
         capabilities.rename = capabilities_pt->second.get<bool>("renameProvider", false);
+        auto semantic_tokens_it = capabilities_pt->second.find("semanticTokensProvider");
+        if(semantic_tokens_it != capabilities_pt->second.not_found()) {
+          if(auto full = semantic_tokens_it->second.get_child_optional("full")) {
+            capabilities.semantic_tokens = full->get_value<bool>(false) || !full->empty();
+            capabilities.semantic_tokens_delta = full->get<bool>("delta", false);
+          }
+          for(auto &type : semantic_tokens_it->second.get_child("legend.tokenTypes", boost::property_tree::ptree()))
+            capabilities.semantic_token_types.emplace_back(type.second.get_value<std::string>());
+        }
       }
 
       write_notification("initialized", "");
@@ -157,147 +413,169 @@ void LanguageProtocol::Client::close(Source::LanguageProtocolView *view) {
     else
       it++;
   }
+  for(auto it = latest_requests.begin(); it != latest_requests.end();) {
+    if(it->first.first == view)
+      it = latest_requests.erase(it);
+    else
+      it++;
+  }
 }
 
-void LanguageProtocol::Client::parse_server_message() {
-  if(!header_read) {
-    server_message_size = static_cast<size_t>(-1);
-    server_message_stream.seekg(0, std::ios::beg);
-
-    std::string line;
-    while(!header_read && std::getline(server_message_stream, line)) {
-      if(!line.empty()) {
-        if(line.back() == '\r')
-          line.pop_back();
-        if(line.compare(0, 16, "Content-Length: ") == 0) {
-          try {
-            server_message_size = static_cast<size_t>(std::stoul(line.substr(16)));
-          }
-          catch(...) {
-          }
-        }
-      }
-      if(line.empty() && server_message_size != static_cast<size_t>(-1)) {
-        server_message_content_pos = server_message_stream.tellg();
-        server_message_size += server_message_content_pos;
-        header_read = true;
+void LanguageProtocol::MessageFramer::write(const char *bytes, size_t n, const std::function<void(const char *content, size_t size)> &on_message) {
+  buffer.append(bytes, n);
+  size_t pos = 0;
+  while(true) {
+    if(content_size == static_cast<size_t>(-1)) {
+      auto header_end = buffer.find("\r\n\r\n", pos);
+      if(header_end == std::string::npos)
+        break;
+      for(auto line_start = pos; line_start < header_end;) {
+        auto line_end = buffer.find("\r\n", line_start);
+        if(line_end > header_end)
+          line_end = header_end;
+        if(buffer.compare(line_start, 15, "Content-Length:") == 0)
+          content_size = std::strtoul(buffer.c_str() + line_start + 15, nullptr, 10);
+        line_start = line_end + 2;
       }
+      pos = header_end + 4;
+      if(content_size == static_cast<size_t>(-1)) // Skip header without Content-Length
+        continue;
+      content_pos = pos;
     }
+    if(buffer.size() - content_pos < content_size)
+      break;
+    on_message(buffer.data() + content_pos, content_size);
+    pos = content_pos + content_size;
+    content_size = static_cast<size_t>(-1);
+  }
+  if(pos > 0) {
+    buffer.erase(0, pos);
+    if(content_size != static_cast<size_t>(-1))
+      content_pos -= pos;
   }
+}
 
-  if(header_read) {
-    server_message_stream.seekg(0, std::ios::end);
-    size_t read_size = server_message_stream.tellg();
-    std::stringstream tmp;
-    if(read_size >= server_message_size) {
-      if(read_size > server_message_size) {
-        server_message_stream.seekg(server_message_size, std::ios::beg);
-        server_message_stream.seekp(server_message_size, std::ios::beg);
-        for(size_t c = server_message_size; c < read_size; ++c) {
-          tmp.put(server_message_stream.get());
-          server_message_stream.put(' ');
-        }
-      }
+LanguageProtocol::Message::Message(const char *content, size_t size) {
+  JSONReader reader(content, content + size);
+  reader.expect('{');
+  if(reader.consume('}'))
+    return;
+  std::string key;
+  do {
+    reader.read_string(key);
+    reader.expect(':');
+    if(key == "id") {
+      boost::property_tree::ptree id_pt;
+      reader.read(id_pt);
+      id = id_pt.get_value<size_t>(0);
+    }
+    else if(key == "method")
+      reader.read_string(method);
+    else if(key == "result") {
+      reader.raw_key = "data"; // The data of completion items is sent back unchanged in completionItem/resolve
+      reader.read(result);
+      reader.raw_key.clear();
+      has_result = true;
+    }
+    else if(key == "error") {
+      reader.read(error);
+      has_error = true;
+    }
+    else if(key == "params") {
+      reader.read(params);
+      has_params = true;
+    }
+    else
+      reader.skip_value();
+  } while(reader.consume(','));
+  reader.expect('}');
+}
 
-      server_message_stream.seekg(server_message_content_pos, std::ios::beg);
-      boost::property_tree::ptree pt;
-      boost::property_tree::read_json(server_message_stream, pt);
+void LanguageProtocol::Client::parse_server_message(const char *content, size_t size) {
+  if(Config::get().log.language_server) {
+    std::cout << "language server: ";
+    std::cout.write(content, size);
+    std::cout << std::endl;
+  }
 
-      if(Config::get().log.language_server) {
-        std::cout << "language server: ";
-        boost::property_tree::write_json(std::cout, pt);
-      }
+  std::unique_ptr<Message> message;
+  try {
+    message = std::make_unique<Message>(content, size);
+  }
+  catch(const std::exception &e) {
+    std::cerr << "Error parsing language server message: " << e.what() << std::endl;
+    return;
+  }
 
-      auto message_id = pt.get<size_t>("id", 0);
-      auto result_it = pt.find("result");
-      auto error_it = pt.find("error");
-      {
-        std::unique_lock<std::mutex> lock(read_write_mutex);
-        if(result_it != pt.not_found()) {
-          if(message_id) {
-            auto id_it = handlers.find(message_id);
-            if(id_it != handlers.end()) {
-              auto function = std::move(id_it->second.second);
-              handlers.erase(id_it->first);
-              lock.unlock();
-              function(result_it->second, false);
-              lock.lock();
-            }
-          }
-        }
-        else if(error_it != pt.not_found()) {
-          if(!Config::get().log.language_server)
-            boost::property_tree::write_json(std::cerr, pt);
-          if(message_id) {
-            auto id_it = handlers.find(message_id);
-            if(id_it != handlers.end()) {
-              auto function = std::move(id_it->second.second);
-              handlers.erase(id_it->first);
-              lock.unlock();
-              function(result_it->second, true);
-              lock.lock();
-            }
-          }
-        }
-        else {
-          auto method_it = pt.find("method");
-          if(method_it != pt.not_found()) {
-            auto params_it = pt.find("params");
-            if(params_it != pt.not_found()) {
-              lock.unlock();
-              handle_server_request(method_it->second.get_value<std::string>(""), params_it->second);
-              lock.lock();
-            }
-          }
-        }
+  std::unique_lock<std::mutex> lock(read_write_mutex);
+  if(message->id && (message->has_result || message->has_error) && cancelled_ids.erase(message->id) > 0) {
+    // RequestCancelled error replies to requests cancelled by the client are expected, and not printed
+    if(message->has_error && message->error.get<int>("code", 0) == -32800)
+      return;
+  }
+  if(message->has_result) {
+    if(message->id) {
+      auto id_it = handlers.find(message->id);
+      if(id_it != handlers.end()) {
+        auto function = std::move(id_it->second.second);
+        handlers.erase(id_it->first);
+        ++completed_requests;
+        lock.unlock();
+        function(message->result, false);
+        lock.lock();
       }
-
-      server_message_stream = std::stringstream();
-      header_read = false;
-      server_message_size = static_cast<size_t>(-1);
-
-      tmp.seekg(0, std::ios::end);
-      if(tmp.tellg() > 0) {
-        tmp.seekg(0, std::ios::beg);
-        server_message_stream << tmp.rdbuf();
-        parse_server_message();
+    }
+  }
+  else if(message->has_error) {
+    if(!Config::get().log.language_server) {
+      std::cerr << "language server: ";
+      std::cerr.write(content, size);
+      std::cerr << std::endl;
+    }
+    if(message->id) {
+      auto id_it = handlers.find(message->id);
+      if(id_it != handlers.end()) {
+        auto function = std::move(id_it->second.second);
+        handlers.erase(id_it->first);
+        ++completed_requests;
+        lock.unlock();
+        function(message->error, true);
+        lock.lock();
       }
     }
   }
+  else if(!message->method.empty() && message->has_params) {
+    lock.unlock();
+    handle_server_request(message->method, message->params);
+    lock.lock();
+  }
 }
 
-void LanguageProtocol::Client::write_request(Source::LanguageProtocolView *view, const std::string &method, const std::string &params, std::function<void(const boost::property_tree::ptree &, bool error)> &&function) {
+void LanguageProtocol::Client::write_request(Source::LanguageProtocolView *view, const std::string &method, const std::string &params, std::function<void(const boost::property_tree::ptree &, bool error)> &&function, const std::string &request_class) {
   std::unique_lock<std::mutex> lock(read_write_mutex);
+  if(!request_class.empty()) {
+    auto &latest_request = latest_requests[std::make_pair(view, request_class)];
+    auto id_it = handlers.find(latest_request);
+    if(id_it != handlers.end()) {
+      handlers.erase(id_it);
+      ++cancelled_requests;
+      cancelled_ids.emplace(latest_request);
+      write_message(R"({"jsonrpc":"2.0","method":"$/cancelRequest","params":{"id":)" + std::to_string(latest_request) + "}}");
+    }
+    latest_request = message_id;
+  }
+  ++sent_requests;
   if(function) {
     handlers.emplace(message_id, std::make_pair(view, std::move(function)));
 
-    auto message_id = this->message_id;
-    std::unique_lock<std::mutex> lock(timeout_threads_mutex);
-    timeout_threads.emplace_back([this, message_id] {
-      for(size_t c = 0; c < 20; ++c) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        std::unique_lock<std::mutex> lock(read_write_mutex);
-        auto id_it = handlers.find(message_id);
-        if(id_it == handlers.end())
-          return;
-      }
-      std::unique_lock<std::mutex> lock(read_write_mutex);
-      auto id_it = handlers.find(message_id);
-      if(id_it != handlers.end()) {
-        Terminal::get().async_print("Request to language server timed out. If you suspect the server has crashed, please close and reopen all project source files.\n", true);
-        auto function = std::move(id_it->second.second);
-        handlers.erase(id_it->first);
-        lock.unlock();
-        function(boost::property_tree::ptree(), true);
-        lock.lock();
-      }
-    });
+    std::unique_lock<std::mutex> lock(timeouts_mutex);
+    auto notify = timeouts.empty(); // timeout_thread is otherwise already waiting for an earlier deadline
+    timeouts.emplace(std::chrono::steady_clock::now() + std::chrono::seconds(10), message_id);
+    lock.unlock();
+    if(notify)
+      timeouts_condition_variable.notify_one();
   }
-  std::string content(R"({"jsonrpc":"2.0","id":)" + std::to_string(message_id++) + R"(,"method":")" + method + R"(","params":{)" + params + "}}");
-  auto message = "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
-  if(Config::get().log.language_server)
-    std::cout << "Language client: " << content << std::endl;
-  if(!process->write(message)) {
+  if(!write_message(R"({"jsonrpc":"2.0","id":)" + std::to_string(message_id++) + R"(,"method":")" + method + R"(","params":{)" + params + "}}")) {
     Terminal::get().async_print("Error writing to language protocol server. Please close and reopen all project source files.\n", true);
     auto id_it = handlers.find(message_id - 1);
     if(id_it != handlers.end()) {
@@ -312,11 +590,25 @@ void LanguageProtocol::Client::write_request(Source::LanguageProtocolView *view,
 
 void LanguageProtocol::Client::write_notification(const std::string &method, const std::string &params) {
   std::unique_lock<std::mutex> lock(read_write_mutex);
-  std::string content(R"({"jsonrpc":"2.0","method":")" + method + R"(","params":{)" + params + "}}");
-  auto message = "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+  write_message(R"({"jsonrpc":"2.0","method":")" + method + R"(","params":{)" + params + "}}");
+}
+
+bool LanguageProtocol::Client::write_message(const std::string &content) {
   if(Config::get().log.language_server)
     std::cout << "Language client: " << content << std::endl;
-  process->write(message);
+  auto message = "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+  if(record_stream)
+    record('>', message.data(), message.size());
+  return process->write(message);
+}
+
+void LanguageProtocol::Client::record(char direction, const char *bytes, size_t n) {
+  std::unique_lock<std::mutex> lock(record_mutex);
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - record_start_time).count();
+  *record_stream << direction << ' ' << time << ' ' << n << '\n';
+  record_stream->write(bytes, n);
+  *record_stream << '\n';
+  record_stream->flush();
 }
 
 void LanguageProtocol::Client::handle_server_request(const std::string &method, const boost::property_tree::ptree &params) {
@@ -341,6 +633,26 @@ void LanguageProtocol::Client::handle_server_request(const std::string &method,
       }
     }
   }
+  else if(method == "$/progress") {
+    auto token = params.get<std::string>("token", "");
+    auto value_it = params.find("value");
+    if(value_it != params.not_found()) {
+      std::lock_guard<std::mutex> lock(progress_handlers_mutex);
+      auto it = progress_handlers.find(token);
+      if(it != progress_handlers.end())
+        it->second(value_it->second);
+    }
+  }
+}
+
+void LanguageProtocol::Client::add_progress_handler(const std::string &token, std::function<void(const boost::property_tree::ptree &)> &&function) {
+  std::lock_guard<std::mutex> lock(progress_handlers_mutex);
+  progress_handlers[token] = std::move(function);
+}
+
+void LanguageProtocol::Client::remove_progress_handler(const std::string &token) {
+  std::lock_guard<std::mutex> lock(progress_handlers_mutex);
+  progress_handlers.erase(token);
 }
 
 Source::LanguageProtocolView::LanguageProtocolView(const boost::filesystem::path &file_path, const Glib::RefPtr<Gsv::Language> &language, std::string language_id_)
@@ -349,6 +661,8 @@ Source::LanguageProtocolView::LanguageProtocolView(const boost::filesystem::path
   get_source_buffer()->set_language(language);
   get_source_buffer()->set_highlight_syntax(true);
 
+  utf16_index.reset(get_buffer()->get_line_count());
+
   if(language_id == "javascript") {
     boost::filesystem::path project_path;
     auto build = Project::Build::create(file_path);
@@ -367,35 +681,49 @@ Source::LanguageProtocolView::LanguageProtocolView(const boost::filesystem::path
   initialize(true);
 
   get_buffer()->signal_insert().connect([this](const Gtk::TextBuffer::iterator &start, const Glib::ustring &text_, int bytes) {
-    std::string content_changes;
     if(capabilities.text_document_sync == LanguageProtocol::Capabilities::TextDocumentSync::NONE)
       return;
     if(capabilities.text_document_sync == LanguageProtocol::Capabilities::TextDocumentSync::INCREMENTAL) {
       std::string text = text_;
       escape_text(text);
-      content_changes = R"({"range":{"start":{"line": )" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(start.get_line_offset()) + R"(},"end":{"line":)" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(start.get_line_offset()) + R"(}},"text":")" + text + "\"}";
+      if(!content_changes.empty())
+        content_changes += ',';
+      content_changes += R"({"range":{"start":{"line": )" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(get_line_pos(start)) + R"(},"end":{"line":)" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(get_line_pos(start)) + R"(}},"text":")" + text + "\"}";
     }
-    else {
-      std::string text = get_buffer()->get_text();
-      escape_text(text);
-      content_changes = R"({"text":")" + text + "\"}";
+    content_changed = true;
+    if(!content_changes_connection.connected()) {
+      content_changes_connection = Glib::signal_idle().connect([this] {
+        flush_content_changes();
+        return false;
+      });
     }
-    client->write_notification("textDocument/didChange", R"("textDocument":{"uri":"file://)" + this->file_path.string() + R"(","version":)" + std::to_string(document_version++) + "},\"contentChanges\":[" + content_changes + "]");
   }, false);
 
   get_buffer()->signal_erase().connect([this](const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end) {
-    std::string content_changes;
     if(capabilities.text_document_sync == LanguageProtocol::Capabilities::TextDocumentSync::NONE)
       return;
-    if(capabilities.text_document_sync == LanguageProtocol::Capabilities::TextDocumentSync::INCREMENTAL)
-      content_changes = R"({"range":{"start":{"line": )" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(start.get_line_offset()) + R"(},"end":{"line":)" + std::to_string(end.get_line()) + ",\"character\":" + std::to_string(end.get_line_offset()) + R"(}},"text":""})";
-    else {
-      std::string text = get_buffer()->get_text();
-      escape_text(text);
-      content_changes = R"({"text":")" + text + "\"}";
+    if(capabilities.text_document_sync == LanguageProtocol::Capabilities::TextDocumentSync::INCREMENTAL) {
+      if(!content_changes.empty())
+        content_changes += ',';
+      content_changes += R"({"range":{"start":{"line": )" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(get_line_pos(start)) + R"(},"end":{"line":)" + std::to_string(end.get_line()) + ",\"character\":" + std::to_string(get_line_pos(end)) + R"(}},"text":""})";
+    }
+    content_changed = true;
+    if(!content_changes_connection.connected()) {
+      content_changes_connection = Glib::signal_idle().connect([this] {
+        flush_content_changes();
+        return false;
+      });
     }
-    client->write_notification("textDocument/didChange", R"("textDocument":{"uri":"file://)" + this->file_path.string() + R"(","version":)" + std::to_string(document_version++) + "},\"contentChanges\":[" + content_changes + "]");
   }, false);
+
+  // The UTF-16 index is updated after changes, using the change in line count since line breaks can be \n, \r\n or \r
+  get_buffer()->signal_insert().connect([this](const Gtk::TextBuffer::iterator &end, const Glib::ustring &text, int bytes) {
+    auto new_lines = get_buffer()->get_line_count() - utf16_index.get_line_count();
+    utf16_index.insert(end.get_line() - new_lines, new_lines);
+  });
+  get_buffer()->signal_erase().connect([this](const Gtk::TextBuffer::iterator &start, const Gtk::TextBuffer::iterator &end) {
+    utf16_index.erase(start.get_line(), utf16_index.get_line_count() - get_buffer()->get_line_count());
+  });
 }
 
 void Source::LanguageProtocolView::initialize(bool setup) {
@@ -416,9 +744,17 @@ void Source::LanguageProtocolView::initialize(bool setup) {
     dispatcher.post([this, capabilities, setup] {
       this->capabilities = capabilities;
 
+      // Changes made before textDocument/didOpen are included in its text
+      content_changes_connection.disconnect();
+      content_changes.clear();
+      content_changed = false;
+
       std::string text = get_buffer()->get_text();
       escape_text(text);
       client->write_notification("textDocument/didOpen", R"("textDocument":{"uri":"file://)" + file_path.string() + R"(","languageId":")" + language_id + R"(","version":)" + std::to_string(document_version++) + R"(,"text":")" + text + "\"}");
+      clear_response_cache();
+
+      setup_semantic_tokens();
 
       if(setup) {
         setup_autocomplete();
@@ -437,6 +773,14 @@ void Source::LanguageProtocolView::initialize(bool setup) {
 
 void Source::LanguageProtocolView::close() {
   autocomplete_delayed_show_arguments_connection.disconnect();
+  // Changes are sent before didClose, so that the server does not miss the last edits
+  flush_content_changes();
+  delayed_semantic_tokens_connection.disconnect();
+  semantic_tokens_idle_connection.disconnect();
+  delayed_diagnostics_connection.disconnect();
+  diagnostics_idle_connection.disconnect();
+  semantic_tokens = LanguageProtocol::SemanticTokens();
+  clear_response_cache();
 
   if(initialize_thread.joinable())
     initialize_thread.join();
@@ -447,6 +791,7 @@ void Source::LanguageProtocolView::close() {
 
   client->write_notification("textDocument/didClose", R"("textDocument":{"uri":"file://)" + file_path.string() + "\"}");
   client->close(this);
+  LanguageProtocol::Client::keep_alive(std::move(client));
   client = nullptr;
 }
 
@@ -465,12 +810,243 @@ bool Source::LanguageProtocolView::save() {
   if(!Source::View::save())
     return false;
 
+  // Batched changes, including changes from formatting on save, are sent before didSave
+  flush_content_changes();
+  client->write_notification("textDocument/didSave", R"("textDocument":{"uri":"file://)" + file_path.string() + "\"}");
+
   if(!flow_coverage_executable.empty())
     add_flow_coverage_tooltips(false);
 
   return true;
 }
 
+void Source::LanguageProtocolView::flush_content_changes() {
+  content_changes_connection.disconnect();
+  if(!content_changed)
+    return;
+  content_changed = false;
+
+  std::string content_changes;
+  if(capabilities.text_document_sync == LanguageProtocol::Capabilities::TextDocumentSync::INCREMENTAL)
+    content_changes = std::move(this->content_changes);
+  else {
+    std::string text = get_buffer()->get_text();
+    escape_text(text);
+    content_changes = R"({"text":")" + text + "\"}";
+  }
+  this->content_changes.clear();
+  client->write_notification("textDocument/didChange", R"("textDocument":{"uri":"file://)" + file_path.string() + R"(","version":)" + std::to_string(document_version++) + "},\"contentChanges\":[" + content_changes + "]");
+  clear_response_cache();
+
+  if(capabilities.semantic_tokens) {
+    delayed_semantic_tokens_connection.disconnect();
+    delayed_semantic_tokens_connection = Glib::signal_timeout().connect([this] {
+      request_semantic_tokens();
+      return false;
+    }, 500);
+  }
+}
+
+void Source::LanguageProtocolView::clear_response_cache() {
+  std::lock_guard<std::mutex> lock(response_cache_mutex);
+  response_cache.clear();
+  response_cache_version = document_version;
+}
+
+void Source::LanguageProtocolView::write_cached_request(const std::string &method, const std::string &key, const std::string &params, std::function<void(const boost::property_tree::ptree &, bool)> &&function, const std::string &request_class) {
+  flush_content_changes();
+  std::shared_ptr<boost::property_tree::ptree> cached_result;
+  size_t version;
+  {
+    std::lock_guard<std::mutex> lock(response_cache_mutex);
+    auto it = response_cache.find({method, key});
+    if(it != response_cache.end())
+      cached_result = it->second;
+    version = response_cache_version;
+  }
+  if(cached_result) {
+    function(*cached_result, false);
+    return;
+  }
+  client->write_request(this, method, R"("textDocument":{"uri":"file://)" + file_path.string() + "\"}" + (params.empty() ? "" : ", " + params), [this, method, key, version, function = std::move(function)](const boost::property_tree::ptree &result, bool error) {
+    if(!error) {
+      std::lock_guard<std::mutex> lock(response_cache_mutex);
+      if(version == response_cache_version)
+        response_cache.emplace(std::make_pair(method, key), std::make_shared<boost::property_tree::ptree>(result));
+    }
+    function(result, error);
+  }, request_class);
+}
+
+void Source::LanguageProtocolView::configure() {
+  Source::View::configure();
+
+  auto scheme = get_source_buffer()->get_style_scheme();
+  for(auto &pair : semantic_token_style_tags) {
+    auto style = scheme->get_style(pair.first);
+    if(style) {
+      if(style->property_foreground_set())
+        pair.second->property_foreground() = style->property_foreground();
+      if(style->property_background_set())
+        pair.second->property_background() = style->property_background();
+    }
+  }
+}
+
+const std::map<std::string, std::string> &Source::LanguageProtocolView::semantic_token_styles() {
+  static std::map<std::string, std::string> styles{
+      {"namespace", "def:type"},
+      {"type", "def:type"},
+      {"class", "def:type"},
+      {"enum", "def:type"},
+      {"interface", "def:type"},
+      {"struct", "def:type"},
+      {"typeParameter", "def:type"},
+      {"parameter", "def:identifier"},
+      {"variable", "def:identifier"},
+      {"property", "def:identifier"},
+      {"enumMember", "def:identifier"},
+      {"function", "def:function"},
+      {"method", "def:function"},
+      {"keyword", "def:statement"},
+      {"comment", "def:comment"},
+      {"string", "def:string"}};
+  return styles;
+}
+
+void Source::LanguageProtocolView::setup_semantic_tokens() {
+  semantic_token_tags.clear();
+  if(!capabilities.semantic_tokens)
+    return;
+
+  auto tag_table = get_buffer()->get_tag_table();
+  for(auto &type : capabilities.semantic_token_types) {
+    auto it = semantic_token_styles().find(type);
+    if(it == semantic_token_styles().end()) {
+      semantic_token_tags.emplace_back(nullptr);
+      continue;
+    }
+    auto tag_it = semantic_token_style_tags.find(it->second);
+    if(tag_it == semantic_token_style_tags.end()) {
+      auto tag = tag_table->lookup(it->second);
+      if(!tag)
+        tag = get_buffer()->create_tag(it->second);
+      tag_it = semantic_token_style_tags.emplace(it->second, tag).first;
+    }
+    semantic_token_tags.emplace_back(tag_it->second);
+  }
+  configure();
+
+  request_semantic_tokens();
+}
+
+void Source::LanguageProtocolView::request_semantic_tokens() {
+  if(!capabilities.semantic_tokens)
+    return;
+
+  flush_content_changes();
+  delayed_semantic_tokens_connection.disconnect();
+  auto version = document_version;
+  bool delta = capabilities.semantic_tokens_delta && !semantic_tokens.result_id.empty();
+  std::string method = delta ? "textDocument/semanticTokens/full/delta" : "textDocument/semanticTokens/full";
+  std::string params = R"("textDocument":{"uri":"file://)" + file_path.string() + "\"}";
+  if(delta)
+    params += R"(,"previousResultId":")" + semantic_tokens.result_id + '"';
+  client->write_request(this, method, params, [this, version](const boost::property_tree::ptree &result, bool error) {
+    if(error) {
+      // Request all tokens next time
+      dispatcher.post([this] {
+        semantic_tokens.result_id.clear();
+      });
+      return;
+    }
+    auto result_id = result.get<std::string>("resultId", "");
+    auto edits_pt = result.get_child_optional("edits");
+    std::vector<LanguageProtocol::SemanticTokens::Edit> edits;
+    std::vector<int> data;
+    try {
+      if(edits_pt) {
+        for(auto it = edits_pt->begin(); it != edits_pt->end(); ++it)
+          edits.emplace_back(it->second);
+      }
+      else
+        data = LanguageProtocol::SemanticTokens::read_data(result.get_child("data", boost::property_tree::ptree()));
+    }
+    catch(...) {
+      dispatcher.post([this] {
+        semantic_tokens.result_id.clear();
+      });
+      return;
+    }
+    dispatcher.post([this, version, result_id = std::move(result_id), is_delta = static_cast<bool>(edits_pt), edits = std::move(edits), data = std::move(data)]() mutable {
+      bool update_all = !is_delta || semantic_tokens_outdated;
+      std::pair<size_t, size_t> changed;
+      if(is_delta) {
+        try {
+          changed = semantic_tokens.apply(std::move(edits));
+        }
+        catch(const std::out_of_range &) {
+          semantic_tokens.result_id.clear();
+          return;
+        }
+      }
+      else
+        semantic_tokens.set(std::move(data));
+      semantic_tokens.result_id = std::move(result_id);
+      semantic_tokens_outdated = version != document_version;
+
+      if(update_all)
+        update_semantic_tokens();
+      else if(changed.first != changed.second) {
+        // Retag from the token before the changed tokens to the first unchanged token after them,
+        // which covers the removed tokens as well
+        auto &tokens = semantic_tokens.tokens;
+        int start_line = changed.first > 0 ? tokens[changed.first - 1].line : 0;
+        int end_line = changed.second < tokens.size() ? tokens[changed.second].line : std::numeric_limits<int>::max();
+        update_semantic_tokens(start_line, end_line);
+      }
+    });
+  }, "semantic_tokens");
+}
+
+void Source::LanguageProtocolView::update_semantic_tokens() {
+  semantic_tokens_idle_connection.disconnect();
+
+  Gdk::Rectangle visible_rect;
+  get_visible_rect(visible_rect);
+  Gtk::TextIter start_iter, end_iter;
+  get_iter_at_location(start_iter, visible_rect.get_x(), visible_rect.get_y());
+  get_iter_at_location(end_iter, visible_rect.get_x(), visible_rect.get_y() + visible_rect.get_height());
+  int start_line = start_iter.get_line(), end_line = end_iter.get_line();
+  update_semantic_tokens(start_line, end_line);
+
+  semantic_tokens_idle_connection = Glib::signal_idle().connect([this, start_line, end_line] {
+    if(start_line > 0)
+      update_semantic_tokens(0, start_line - 1);
+    update_semantic_tokens(end_line + 1, std::numeric_limits<int>::max());
+    return false;
+  });
+}
+
+void Source::LanguageProtocolView::update_semantic_tokens(int start_line, int end_line) {
+  auto buffer = get_buffer();
+  if(start_line >= buffer->get_line_count())
+    return;
+  auto start = buffer->get_iter_at_line(start_line);
+  auto end = end_line < buffer->get_line_count() - 1 ? buffer->get_iter_at_line(end_line + 1) : buffer->end();
+  for(auto &pair : semantic_token_style_tags)
+    buffer->remove_tag(pair.second, start, end);
+
+  auto &tokens = semantic_tokens.tokens;
+  auto it = std::lower_bound(tokens.begin(), tokens.end(), start_line, [](const LanguageProtocol::SemanticTokens::Token &token, int line) {
+    return token.line < line;
+  });
+  for(; it != tokens.end() && it->line <= end_line; ++it) {
+    if(it->type >= 0 && static_cast<size_t>(it->type) < semantic_token_tags.size() && semantic_token_tags[it->type])
+      buffer->apply_tag(semantic_token_tags[it->type], get_iter_at_line_pos(it->line, it->character), get_iter_at_line_pos(it->line, it->character + it->length));
+  }
+}
+
 void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
   if(capabilities.document_formatting) {
     format_style = [this](bool continue_without_style_file) {
@@ -503,13 +1079,14 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
         method = "textDocument/rangeFormatting";
         Gtk::TextIter start, end;
         get_buffer()->get_selection_bounds(start, end);
-        params = R"("textDocument":{"uri":"file://)" + file_path.string() + R"("},"range":{"start":{"line":)" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(start.get_line_offset()) + R"(},"end":{"line":)" + std::to_string(end.get_line()) + ",\"character\":" + std::to_string(end.get_line_offset()) + "}},\"options\":{" + options + "}";
+        params = R"("textDocument":{"uri":"file://)" + file_path.string() + R"("},"range":{"start":{"line":)" + std::to_string(start.get_line()) + ",\"character\":" + std::to_string(get_line_pos(start)) + R"(},"end":{"line":)" + std::to_string(end.get_line()) + ",\"character\":" + std::to_string(get_line_pos(end)) + "}},\"options\":{" + options + "}";
       }
       else {
         method = "textDocument/formatting";
         params = R"("textDocument":{"uri":"file://)" + file_path.string() + R"("},"options":{)" + options + "}";
       }
 
+      flush_content_changes();
       client->write_request(this, method, params, [&text_edits, &result_processed](const boost::property_tree::ptree &result, bool error) {
         if(!error) {
           for(auto it = result.begin(); it != result.end(); ++it) {
@@ -529,7 +1106,7 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
       if(text_edits.size() == 1 &&
          text_edits[0].range.start.line == 0 && text_edits[0].range.start.character == 0 &&
          (text_edits[0].range.end.line > end_iter.get_line() ||
-          (text_edits[0].range.end.line == end_iter.get_line() && text_edits[0].range.end.character >= end_iter.get_line_offset()))) {
+          (text_edits[0].range.end.line == end_iter.get_line() && text_edits[0].range.end.character >= get_line_pos(end_iter)))) {
         replace_text(text_edits[0].new_text);
       }
       else {
@@ -574,7 +1151,8 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
       else
         method = "textDocument/documentHighlight";
 
-      client->write_request(this, method, R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(iter.get_line_offset()) + R"(}, "context": {"includeDeclaration": true})", [this, &locations, &result_processed](const boost::property_tree::ptree &result, bool error) {
+      flush_content_changes();
+      client->write_request(this, method, R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(get_line_pos(iter)) + R"(}, "context": {"includeDeclaration": true})", [this, &locations, &result_processed](const boost::property_tree::ptree &result, bool error) {
         if(!error) {
           try {
             for(auto it = result.begin(); it != result.end(); ++it)
@@ -588,14 +1166,13 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
       });
       result_processed.get_future().get();
 
-      auto embolden_token = [](std::string &line_, int token_start_pos, int token_end_pos) {
-        Glib::ustring line = line_;
+      auto embolden_token = [](std::string &line, int token_start_pos, int token_end_pos) {
         if(static_cast<size_t>(token_start_pos) > line.size() || static_cast<size_t>(token_end_pos) > line.size())
           return;
 
         //markup token as bold
         size_t pos = 0;
-        while((pos = line.find('&', pos)) != Glib::ustring::npos) {
+        while((pos = line.find('&', pos)) != std::string::npos) {
           size_t pos2 = line.find(';', pos + 2);
           if(static_cast<size_t>(token_start_pos) > pos) {
             token_start_pos += pos2 - pos;
@@ -615,8 +1192,6 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
           ++start_pos;
         if(start_pos > 0)
           line.erase(0, start_pos);
-
-        line_ = line.raw();
       };
 
       std::unordered_map<std::string, std::vector<std::string>> file_lines;
@@ -624,8 +1199,16 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
       auto c = static_cast<size_t>(-1);
       for(auto &location : locations) {
         ++c;
-        usages.emplace_back(Offset(location.range.start.line, location.range.start.character, location.file), std::string());
+        usages.emplace_back(Offset(location.range.start.line, 0, location.file), std::string());
         auto &usage = usages.back();
+        // Converts the UTF-16 positions of the location to byte indexes in the line, and adds the line with the token in bold
+        auto add_line = [&usage, &location, &embolden_token](const std::string &line) {
+          auto start_index = LanguageProtocol::Utf16Index::get_line_index(line, location.range.start.character);
+          auto end_index = location.range.end.line == location.range.start.line ? LanguageProtocol::Utf16Index::get_line_index(line, location.range.end.character) : static_cast<int>(line.size());
+          usage.first.index = start_index;
+          usage.second = Glib::Markup::escape_text(line);
+          embolden_token(usage.second, start_index, end_index);
+        };
         auto view_it = views.end();
         for(auto it = views.begin(); it != views.end(); ++it) {
           if(location.file == (*it)->file_path) {
@@ -638,8 +1221,7 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
             auto start = (*view_it)->get_buffer()->get_iter_at_line(location.range.start.line);
             auto end = start;
             end.forward_to_line_end();
-            usage.second = Glib::Markup::escape_text((*view_it)->get_buffer()->get_text(start, end));
-            embolden_token(usage.second, location.range.start.character, location.range.end.character);
+            add_line((*view_it)->get_buffer()->get_text(start, end));
           }
         }
         else {
@@ -663,10 +1245,8 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
             }
           }
 
-          if(static_cast<size_t>(location.range.start.line) < it->second.size()) {
-            usage.second = Glib::Markup::escape_text(it->second[location.range.start.line]);
-            embolden_token(usage.second, location.range.start.character, location.range.end.character);
-          }
+          if(static_cast<size_t>(location.range.start.line) < it->second.size())
+            add_line(it->second[location.range.start.line]);
         }
       }
 
@@ -709,8 +1289,9 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
       auto iter = get_buffer()->get_insert()->get_iter();
       std::vector<Changes> changes;
       std::promise<void> result_processed;
+      flush_content_changes();
       if(capabilities.rename) {
-        client->write_request(this, "textDocument/rename", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(iter.get_line_offset()) + R"(}, "newName": ")" + text + "\"", [this, &changes, &result_processed](const boost::property_tree::ptree &result, bool error) {
+        client->write_request(this, "textDocument/rename", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(get_line_pos(iter)) + R"(}, "newName": ")" + text + "\"", [this, &changes, &result_processed](const boost::property_tree::ptree &result, bool error) {
           if(!error) {
             boost::filesystem::path project_path;
             auto build = Project::Build::create(file_path);
@@ -758,7 +1339,7 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
         });
       }
       else {
-        client->write_request(this, "textDocument/documentHighlight", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(iter.get_line_offset()) + R"(}, "context": {"includeDeclaration": true})", [this, &changes, &text, &result_processed](const boost::property_tree::ptree &result, bool error) {
+        client->write_request(this, "textDocument/documentHighlight", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(get_line_pos(iter)) + R"(}, "context": {"includeDeclaration": true})", [this, &changes, &text, &result_processed](const boost::property_tree::ptree &result, bool error) {
           if(!error) {
             try {
               std::vector<LanguageProtocol::TextEdit> edits;
@@ -793,7 +1374,7 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
           if(change.text_edits.size() == 1 &&
              change.text_edits[0].range.start.line == 0 && change.text_edits[0].range.start.character == 0 &&
              (change.text_edits[0].range.end.line > end_iter.get_line() ||
-              (change.text_edits[0].range.end.line == end_iter.get_line() && change.text_edits[0].range.end.character >= end_iter.get_line_offset())))
+              (change.text_edits[0].range.end.line == end_iter.get_line() && (*view_it)->get_iter_at_line_pos(end_iter.get_line(), change.text_edits[0].range.end.character) == end_iter)))
             (*view_it)->replace_text(change.text_edits[0].new_text);
           else {
             for(auto edit_it = change.text_edits.rbegin(); edit_it != change.text_edits.rend(); ++edit_it) {
@@ -810,7 +1391,7 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
           changes_renamed.emplace_back(&change);
         }
         else {
-          Glib::ustring buffer;
+          std::string buffer;
           {
             std::ifstream stream(change.file, std::ifstream::binary);
             if(stream)
@@ -823,22 +1404,29 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
               if(buffer[c] == '\n')
                 lines_start_pos.emplace_back(c + 1);
             }
+            // Returns the byte offset in buffer of a UTF-16 position
+            auto get_buffer_pos = [&buffer, &lines_start_pos](size_t line, int utf16_pos) {
+              auto line_start = lines_start_pos[line];
+              auto line_end = line + 1 < lines_start_pos.size() ? lines_start_pos[line + 1] - 1 : buffer.size();
+              if(line_end > line_start && buffer[line_end - 1] == '\r')
+                --line_end;
+              return line_start + LanguageProtocol::Utf16Index::get_line_index(buffer.substr(line_start, line_end - line_start), utf16_pos);
+            };
             for(auto edit_it = change.text_edits.rbegin(); edit_it != change.text_edits.rend(); ++edit_it) {
               auto start_line = edit_it->range.start.line;
               auto end_line = edit_it->range.end.line;
               if(static_cast<size_t>(start_line) < lines_start_pos.size()) {
-                auto start = lines_start_pos[start_line] + edit_it->range.start.character;
+                auto start = get_buffer_pos(start_line, edit_it->range.start.character);
                 size_t end;
                 if(static_cast<size_t>(end_line) >= lines_start_pos.size())
                   end = buffer.size();
                 else
-                  end = lines_start_pos[end_line] + edit_it->range.end.character;
-                if(start < buffer.size() && end <= buffer.size()) {
+                  end = get_buffer_pos(end_line, edit_it->range.end.character);
+                if(start <= end && end <= buffer.size())
                   buffer.replace(start, end - start, edit_it->new_text);
-                }
               }
             }
-            stream.write(buffer.data(), buffer.bytes());
+            stream.write(buffer.data(), buffer.size());
             changes_renamed.emplace_back(&change);
           }
           else
@@ -861,7 +1449,7 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
       std::vector<std::pair<Offset, std::string>> methods;
 
       std::promise<void> result_processed;
-      client->write_request(this, "textDocument/documentSymbol", R"("textDocument":{"uri":"file://)" + file_path.string() + "\"}", [&result_processed, &methods](const boost::property_tree::ptree &result, bool error) {
+      write_cached_request("textDocument/documentSymbol", "", "", [&result_processed, &methods](const boost::property_tree::ptree &result, bool error) {
         if(!error) {
           for(auto it = result.begin(); it != result.end(); ++it) {
             try {
@@ -886,6 +1474,9 @@ void Source::LanguageProtocolView::setup_navigation_and_refactoring() {
       });
       result_processed.get_future().get();
 
+      for(auto &method : methods)
+        method.first.index = get_iter_at_line_pos(method.first.line, method.first.index).get_line_index();
+
       return methods;
     };
   }
@@ -916,68 +1507,194 @@ void Source::LanguageProtocolView::escape_text(std::string &text) {
   }
 }
 
-void Source::LanguageProtocolView::update_diagnostics(std::vector<LanguageProtocol::Diagnostic> &&diagnostics) {
-  dispatcher.post([this, diagnostics = std::move(diagnostics)]() mutable {
-    clear_diagnostic_tooltips();
-    num_warnings = 0;
-    num_errors = 0;
-    num_fix_its = 0;
-    for(auto &diagnostic : diagnostics) {
-      auto start = get_iter_at_line_pos(diagnostic.range.start.line, diagnostic.range.start.character);
-      auto end = get_iter_at_line_pos(diagnostic.range.end.line, diagnostic.range.end.character);
-
-      if(start == end) {
-        if(!end.is_end())
-          end.forward_char();
-        else
-          start.backward_char();
-      }
+const std::chrono::milliseconds Source::LanguageProtocolView::diagnostics_interval(250);
 
-      bool error = false;
-      std::string severity_tag_name;
-      if(diagnostic.severity >= 2) {
-        severity_tag_name = "def:warning";
-        num_warnings++;
-      }
-      else {
-        severity_tag_name = "def:error";
-        num_errors++;
-        error = true;
-      }
+void Source::LanguageProtocolView::update_diagnostics(std::vector<LanguageProtocol::Diagnostic> &&diagnostics) {
+  {
+    std::lock_guard<std::mutex> lock(pending_diagnostics_mutex);
+    bool posted = pending_diagnostics != nullptr;
+    pending_diagnostics = std::make_unique<std::vector<LanguageProtocol::Diagnostic>>(std::move(diagnostics));
+    if(posted) // Newer diagnostics replace the ones not yet applied
+      return;
+  }
+  dispatcher.post([this] {
+    auto elapsed = std::chrono::steady_clock::now() - diagnostics_applied_time;
+    if(elapsed >= diagnostics_interval)
+      apply_diagnostics();
+    else if(!delayed_diagnostics_connection.connected()) {
+      delayed_diagnostics_connection = Glib::signal_timeout().connect([this] {
+        apply_diagnostics();
+        return false;
+      }, std::chrono::duration_cast<std::chrono::milliseconds>(diagnostics_interval - elapsed).count() + 1);
+    }
+  });
+}
 
-      add_diagnostic_tooltip(start, end, error, [this, diagnostic = std::move(diagnostic)](const Glib::RefPtr<Gtk::TextBuffer> &buffer) {
-        buffer->insert_at_cursor(diagnostic.message);
-
-        for(size_t i = 0; i < diagnostic.related_informations.size(); ++i) {
-          auto link = filesystem::get_relative_path(diagnostic.related_informations[i].location.file, file_path.parent_path()).string();
-          link += ':' + std::to_string(diagnostic.related_informations[i].location.range.start.line + 1);
-          link += ':' + std::to_string(diagnostic.related_informations[i].location.range.start.character + 1);
-
-          if(i == 0)
-            buffer->insert_at_cursor("\n\n");
-          buffer->insert_at_cursor(diagnostic.related_informations[i].message);
-          buffer->insert_at_cursor(": ");
-          auto pos = buffer->get_insert()->get_iter();
-          buffer->insert_with_tag(pos, link, link_tag);
-          if(i != diagnostic.related_informations.size() - 1)
-            buffer->insert_at_cursor("\n");
-        }
-      });
+void Source::LanguageProtocolView::apply_diagnostics() {
+  delayed_diagnostics_connection.disconnect();
+  std::unique_ptr<std::vector<LanguageProtocol::Diagnostic>> diagnostics;
+  {
+    std::lock_guard<std::mutex> lock(pending_diagnostics_mutex);
+    diagnostics = std::move(pending_diagnostics);
+  }
+  if(!diagnostics)
+    return;
+  diagnostics_applied_time = std::chrono::steady_clock::now();
+  add_remaining_diagnostic_tooltips();
+
+  std::map<std::string, ShownDiagnostic> new_diagnostics;
+  for(auto &diagnostic : *diagnostics) {
+    std::string key = std::to_string(diagnostic.range.start.line) + ':' + std::to_string(diagnostic.range.start.character) + ':' +
+                      std::to_string(diagnostic.range.end.line) + ':' + std::to_string(diagnostic.range.end.character) + ':' +
+                      std::to_string(diagnostic.severity) + ':' + diagnostic.message;
+    for(auto &related_information : diagnostic.related_informations) {
+      key += '\n' + related_information.location.file + ':' + std::to_string(related_information.location.range.start.line) + ':' +
+             std::to_string(related_information.location.range.start.character) + ':' + related_information.message;
     }
+    auto it = shown_diagnostics.find(key);
+    if(it != shown_diagnostics.end()) {
+      new_diagnostics.emplace(key, std::move(it->second));
+      shown_diagnostics.erase(it);
+    }
+    else {
+      ShownDiagnostic shown_diagnostic;
+      shown_diagnostic.diagnostic = std::make_shared<LanguageProtocol::Diagnostic>(std::move(diagnostic));
+      new_diagnostics.emplace(std::move(key), std::move(shown_diagnostic));
+    }
+  }
 
+  // Remove diagnostics that are no longer reported, and restore the underlines of the
+  // remaining diagnostics on the affected lines since underlines of overlapping diagnostics are shared
+  auto buffer = get_buffer();
+  int removed_start_line = std::numeric_limits<int>::max(), removed_end_line = -1;
+  for(auto &pair : shown_diagnostics) {
+    auto start = pair.second.tooltip->start_mark->get_iter();
+    auto end = pair.second.tooltip->end_mark->get_iter();
+    buffer->remove_tag_by_name("def:warning_underline", start, end);
+    buffer->remove_tag_by_name("def:error_underline", start, end);
+    removed_start_line = std::min(removed_start_line, start.get_line());
+    removed_end_line = std::max(removed_end_line, end.get_line());
+    diagnostic_tooltips.erase(pair.second.tooltip);
+  }
+  shown_diagnostics = std::move(new_diagnostics);
+  if(removed_end_line >= 0) {
+    auto restore_underline = [&](const Gtk::TextIter &start, const Gtk::TextIter &end, bool error) {
+      if(start.get_line() <= removed_end_line && end.get_line() >= removed_start_line)
+        buffer->apply_tag_by_name(error ? "def:error_underline" : "def:warning_underline", start, end);
+    };
+    for(auto &pair : shown_diagnostics) {
+      if(pair.second.tooltip_added)
+        restore_underline(pair.second.tooltip->start_mark->get_iter(), pair.second.tooltip->end_mark->get_iter(), pair.second.diagnostic->severity < 2);
+    }
     for(auto &mark : flow_coverage_marks)
-      add_diagnostic_tooltip(mark.first->get_iter(), mark.second->get_iter(), false, [](const Glib::RefPtr<Gtk::TextBuffer> &buffer) {
-        buffer->insert_at_cursor(flow_coverage_message);
-      });
+      restore_underline(mark.first->get_iter(), mark.second->get_iter(), false);
+  }
 
-    status_diagnostics = std::make_tuple(num_warnings + num_flow_coverage_warnings, num_errors, num_fix_its);
-    if(update_status_diagnostics)
-      update_status_diagnostics(this);
+  // Add new diagnostics on the visible lines first, and the rest when idle
+  Gdk::Rectangle visible_rect;
+  get_visible_rect(visible_rect);
+  Gtk::TextIter visible_start, visible_end;
+  get_iter_at_location(visible_start, visible_rect.get_x(), visible_rect.get_y());
+  get_iter_at_location(visible_end, visible_rect.get_x(), visible_rect.get_y() + visible_rect.get_height());
+  bool remaining = false;
+  for(auto &pair : shown_diagnostics) {
+    if(!pair.second.tooltip_added) {
+      auto &range = pair.second.diagnostic->range;
+      if(range.start.line <= visible_end.get_line() && range.end.line >= visible_start.get_line())
+        add_shown_diagnostic_tooltip(pair.second);
+      else
+        remaining = true;
+    }
+  }
+  if(remaining) {
+    diagnostics_idle_connection = Glib::signal_idle().connect([this] {
+      add_remaining_diagnostic_tooltips();
+      return false;
+    });
+  }
+
+  update_diagnostics_status();
+}
+
+void Source::LanguageProtocolView::add_shown_diagnostic_tooltip(ShownDiagnostic &shown_diagnostic) {
+  auto &diagnostic = *shown_diagnostic.diagnostic;
+  auto start = get_iter_at_line_pos(diagnostic.range.start.line, diagnostic.range.start.character);
+  auto end = get_iter_at_line_pos(diagnostic.range.end.line, diagnostic.range.end.character);
+
+  if(start == end) {
+    if(!end.is_end())
+      end.forward_char();
+    else
+      start.backward_char();
+  }
+
+  shown_diagnostic.tooltip = add_diagnostic_tooltip(start, end, diagnostic.severity < 2, [this, diagnostic = shown_diagnostic.diagnostic](const Glib::RefPtr<Gtk::TextBuffer> &buffer) {
+    buffer->insert_at_cursor(diagnostic->message);
+
+    for(size_t i = 0; i < diagnostic->related_informations.size(); ++i) {
+      auto link = filesystem::get_relative_path(diagnostic->related_informations[i].location.file, file_path.parent_path()).string();
+      link += ':' + std::to_string(diagnostic->related_informations[i].location.range.start.line + 1);
+      link += ':' + std::to_string(diagnostic->related_informations[i].location.range.start.character + 1);
+
+      if(i == 0)
+        buffer->insert_at_cursor("\n\n");
+      buffer->insert_at_cursor(diagnostic->related_informations[i].message);
+      buffer->insert_at_cursor(": ");
+      auto pos = buffer->get_insert()->get_iter();
+      buffer->insert_with_tag(pos, link, link_tag);
+      if(i != diagnostic->related_informations.size() - 1)
+        buffer->insert_at_cursor("\n");
+    }
   });
+  shown_diagnostic.tooltip_added = true;
+}
+
+void Source::LanguageProtocolView::add_remaining_diagnostic_tooltips() {
+  if(!diagnostics_idle_connection.connected())
+    return;
+  diagnostics_idle_connection.disconnect();
+  for(auto &pair : shown_diagnostics) {
+    if(!pair.second.tooltip_added)
+      add_shown_diagnostic_tooltip(pair.second);
+  }
+  update_diagnostics_status();
+}
+
+void Source::LanguageProtocolView::update_diagnostics_status() {
+  num_warnings = 0;
+  num_errors = 0;
+  num_fix_its = 0;
+  diagnostic_offsets.clear();
+  for(auto &pair : shown_diagnostics) {
+    if(pair.second.diagnostic->severity >= 2)
+      num_warnings++;
+    else
+      num_errors++;
+    if(pair.second.tooltip_added)
+      diagnostic_offsets.emplace(pair.second.tooltip->start_mark->get_iter().get_offset());
+  }
+  for(auto &mark : flow_coverage_marks)
+    diagnostic_offsets.emplace(mark.first->get_iter().get_offset());
+
+  status_diagnostics = std::make_tuple(num_warnings + num_flow_coverage_warnings, num_errors, num_fix_its);
+  if(update_status_diagnostics)
+    update_status_diagnostics(this);
 }
 
 Gtk::TextIter Source::LanguageProtocolView::get_iter_at_line_pos(int line, int pos) {
-  return get_iter_at_line_offset(line, pos);
+  return get_iter_at_line_offset(line, utf16_index.get_offset(line, pos, [this](int line) {
+    return get_line_text(line);
+  }));
+}
+
+int Source::LanguageProtocolView::get_line_pos(const Gtk::TextIter &iter) {
+  return utf16_index.get_utf16_pos(iter.get_line(), iter.get_line_offset(), [this](int line) {
+    return get_line_text(line);
+  });
+}
+
+std::string Source::LanguageProtocolView::get_line_text(int line) {
+  return get_buffer()->get_text(get_buffer()->get_iter_at_line(line), get_iter_at_line_end(line));
 }
 
 void Source::LanguageProtocolView::show_type_tooltips(const Gdk::Rectangle &rectangle) {
@@ -999,7 +1716,8 @@ void Source::LanguageProtocolView::show_type_tooltips(const Gdk::Rectangle &rect
   static int request_count = 0;
   request_count++;
   auto current_request = request_count;
-  client->write_request(this, "textDocument/hover", R"("textDocument": {"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(iter.get_line_offset()) + "}", [this, offset, current_request](const boost::property_tree::ptree &result, bool error) {
+  auto position = std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(get_line_pos(iter));
+  write_cached_request("textDocument/hover", position, R"("position": {"line": )" + position + "}", [this, offset, current_request](const boost::property_tree::ptree &result, bool error) {
     if(!error) {
       // hover result structure vary significantly from the different language servers
       auto content = std::make_shared<std::string>();
@@ -1084,7 +1802,7 @@ void Source::LanguageProtocolView::show_type_tooltips(const Gdk::Rectangle &rect
         });
       }
     }
-  });
+  }, "hover");
 }
 
 void Source::LanguageProtocolView::apply_similar_symbol_tag() {
@@ -1101,7 +1819,8 @@ void Source::LanguageProtocolView::apply_similar_symbol_tag() {
   static int request_count = 0;
   request_count++;
   auto current_request = request_count;
-  client->write_request(this, method, R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(iter.get_line_offset()) + R"(}, "context": {"includeDeclaration": true})", [this, current_request](const boost::property_tree::ptree &result, bool error) {
+  auto position = std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(get_line_pos(iter));
+  write_cached_request(method, position, R"("position": {"line": )" + position + R"(}, "context": {"includeDeclaration": true})", [this, current_request](const boost::property_tree::ptree &result, bool error) {
     if(!error) {
       std::vector<LanguageProtocol::Range> ranges;
       std::string uri;
@@ -1126,7 +1845,7 @@ void Source::LanguageProtocolView::apply_similar_symbol_tag() {
         }
       });
     }
-  });
+  }, "similar_symbols");
 }
 
 void Source::LanguageProtocolView::apply_clickable_tag(const Gtk::TextIter &iter) {
@@ -1135,7 +1854,8 @@ void Source::LanguageProtocolView::apply_clickable_tag(const Gtk::TextIter &iter
   auto current_request = request_count;
   auto line = iter.get_line();
   auto offset = iter.get_line_offset();
-  client->write_request(this, "textDocument/definition", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(line) + ", \"character\": " + std::to_string(offset) + "}", [this, current_request, line, offset](const boost::property_tree::ptree &result, bool error) {
+  flush_content_changes();
+  client->write_request(this, "textDocument/definition", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(line) + ", \"character\": " + std::to_string(get_line_pos(iter)) + "}", [this, current_request, line, offset](const boost::property_tree::ptree &result, bool error) {
     if(!error && !result.empty()) {
       dispatcher.post([this, current_request, line, offset] {
         if(current_request != request_count || !clickable_tag_applied)
@@ -1145,13 +1865,14 @@ void Source::LanguageProtocolView::apply_clickable_tag(const Gtk::TextIter &iter
         get_buffer()->apply_tag(clickable_tag, range.first, range.second);
       });
     }
-  });
+  }, "clickable");
 }
 
 Source::Offset Source::LanguageProtocolView::get_declaration(const Gtk::TextIter &iter) {
   auto offset = std::make_shared<Offset>();
   std::promise<void> result_processed;
-  client->write_request(this, "textDocument/definition", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(iter.get_line_offset()) + "}", [offset, &result_processed](const boost::property_tree::ptree &result, bool error) {
+  flush_content_changes();
+  client->write_request(this, "textDocument/definition", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(iter.get_line()) + ", \"character\": " + std::to_string(get_line_pos(iter)) + "}", [offset, &result_processed](const boost::property_tree::ptree &result, bool error) {
     if(!error) {
       for(auto it = result.begin(); it != result.end(); ++it) {
         try {
@@ -1168,9 +1889,34 @@ Source::Offset Source::LanguageProtocolView::get_declaration(const Gtk::TextIter
     result_processed.set_value();
   });
   result_processed.get_future().get();
+  if(*offset)
+    offset->index = get_line_index(offset->file_path.string(), offset->line, offset->index);
   return *offset;
 }
 
+int Source::LanguageProtocolView::get_line_index(const std::string &file, int line, int utf16_pos) {
+  std::string line_text;
+  auto view_it = std::find_if(views.begin(), views.end(), [&file](Source::View *view) { return view->file_path == file; });
+  if(view_it != views.end()) {
+    if(line >= (*view_it)->get_buffer()->get_line_count())
+      return utf16_pos;
+    auto start = (*view_it)->get_buffer()->get_iter_at_line(line);
+    auto end = start;
+    end.forward_to_line_end();
+    line_text = (*view_it)->get_buffer()->get_text(start, end).raw();
+  }
+  else {
+    std::ifstream stream(file, std::ifstream::binary);
+    for(int c = 0; c <= line; ++c) {
+      if(!std::getline(stream, line_text))
+        return utf16_pos;
+    }
+    if(!line_text.empty() && line_text.back() == '\r')
+      line_text.pop_back();
+  }
+  return LanguageProtocol::Utf16Index::get_line_index(line_text, utf16_pos);
+}
+
 void Source::LanguageProtocolView::setup_autocomplete() {
   if(!capabilities.completion)
     return;
@@ -1182,8 +1928,8 @@ void Source::LanguageProtocolView::setup_autocomplete() {
   };
 
   autocomplete.reparse = [this] {
-    autocomplete_comment.clear();
-    autocomplete_insert.clear();
+    autocomplete_items.clear();
+    autocomplete_resolved_comments.clear();
   };
 
   if(capabilities.signature_help) {
@@ -1287,6 +2033,8 @@ void Source::LanguageProtocolView::setup_autocomplete() {
   };
 
   autocomplete.before_add_rows = [this] {
+    flush_content_changes();
+    autocomplete_character = get_line_pos(get_buffer()->get_insert()->get_iter());
     status_state = "autocomplete...";
     if(update_status_state)
       update_status_state(this);
@@ -1299,19 +2047,19 @@ void Source::LanguageProtocolView::setup_autocomplete() {
   };
 
   autocomplete.on_add_rows_error = [this] {
-    autocomplete_comment.clear();
-    autocomplete_insert.clear();
+    autocomplete_items.clear();
+    autocomplete_resolved_comments.clear();
   };
 
   autocomplete.add_rows = [this](std::string &buffer, int line_number, int column) {
     if(autocomplete.state == Autocomplete::State::STARTING) {
-      autocomplete_comment.clear();
-      autocomplete_insert.clear();
+      autocomplete_items.clear();
+      autocomplete_resolved_comments.clear();
       std::promise<void> result_processed;
       if(autocomplete_show_parameters) {
         if(!capabilities.signature_help)
           return;
-        client->write_request(this, "textDocument/signatureHelp", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(line_number - 1) + ", \"character\": " + std::to_string(column - 1) + "}", [this, &result_processed](const boost::property_tree::ptree &result, bool error) {
+        client->write_request(this, "textDocument/signatureHelp", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(line_number - 1) + ", \"character\": " + std::to_string(autocomplete_character) + "}", [this, &result_processed](const boost::property_tree::ptree &result, bool error) {
           if(!error) {
             auto signatures = result.get_child("signatures", boost::property_tree::ptree());
             for(auto signature_it = signatures.begin(); signature_it != signatures.end(); ++signature_it) {
@@ -1320,9 +2068,8 @@ void Source::LanguageProtocolView::setup_autocomplete() {
                 auto label = parameter_it->second.get<std::string>("label", "");
                 auto insert = label;
                 auto documentation = parameter_it->second.get<std::string>("documentation", "");
+                autocomplete_items.emplace_back(label, insert, documentation);
                 autocomplete.rows.emplace_back(std::move(label));
-                autocomplete_insert.emplace_back(std::move(insert));
-                autocomplete_comment.emplace_back(std::move(documentation));
               }
             }
           }
@@ -1330,7 +2077,7 @@ void Source::LanguageProtocolView::setup_autocomplete() {
         });
       }
       else {
-        client->write_request(this, "textDocument/completion", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(line_number - 1) + ", \"character\": " + std::to_string(column - 1) + "}", [this, &result_processed](const boost::property_tree::ptree &result, bool error) {
+        client->write_request(this, "textDocument/completion", R"("textDocument":{"uri":"file://)" + file_path.string() + R"("}, "position": {"line": )" + std::to_string(line_number - 1) + ", \"character\": " + std::to_string(autocomplete_character) + "}", [this, &result_processed](const boost::property_tree::ptree &result, bool error) {
           if(!error) {
             auto begin = result.begin(); // rust language server is bugged
             auto end = result.end();
@@ -1342,7 +2089,7 @@ void Source::LanguageProtocolView::setup_autocomplete() {
             for(auto it = begin; it != end; ++it) {
               auto label = it->second.get<std::string>("label", "");
               auto detail = it->second.get<std::string>("detail", "");
-              auto documentation = it->second.get<std::string>("documentation", "");
+              auto documentation = it->second.get<std::string>("documentation.value", it->second.get<std::string>("documentation", ""));
               auto insert = it->second.get<std::string>("insertText", "");
               if(!insert.empty()) {
                 // In case ( is missing in insert but is present in label
@@ -1372,14 +2119,19 @@ void Source::LanguageProtocolView::setup_autocomplete() {
                 }
               }
               if(!label.empty()) {
-                autocomplete.rows.emplace_back(std::move(label));
-                autocomplete_comment.emplace_back(std::move(detail));
-                if(!documentation.empty() && documentation != autocomplete_comment.back()) {
-                  if(!autocomplete_comment.back().empty())
-                    autocomplete_comment.back() += "\n\n";
-                  autocomplete_comment.back() += documentation;
+                if(!documentation.empty() && documentation != detail) {
+                  if(!detail.empty())
+                    detail += "\n\n";
+                  detail += documentation;
+                }
+                std::string data;
+                if(capabilities.completion_resolve) {
+                  auto data_it = it->second.find("data");
+                  if(data_it != it->second.not_found())
+                    data = data_it->second.data();
                 }
-                autocomplete_insert.emplace_back(std::move(insert));
+                autocomplete_items.emplace_back(label, insert, detail, data);
+                autocomplete.rows.emplace_back(std::move(label));
               }
             }
           }
@@ -1432,12 +2184,12 @@ void Source::LanguageProtocolView::setup_autocomplete() {
   };
 
   autocomplete.on_hide = [this] {
-    autocomplete_comment.clear();
-    autocomplete_insert.clear();
+    autocomplete_items.clear();
+    autocomplete_resolved_comments.clear();
   };
 
   autocomplete.on_select = [this](unsigned int index, const std::string &text, bool hide_window) {
-    Glib::ustring insert = hide_window ? autocomplete_insert[index] : text;
+    Glib::ustring insert = hide_window ? autocomplete_items.get(autocomplete_items.inserts[index]) : text;
 
     get_buffer()->erase(CompletionDialog::get()->start_mark->get_iter(), get_buffer()->get_insert()->get_iter());
 
@@ -1507,11 +2259,48 @@ void Source::LanguageProtocolView::setup_autocomplete() {
       get_buffer()->insert(CompletionDialog::get()->start_mark->get_iter(), insert);
   };
 
+  autocomplete.on_changed = [this](unsigned int index, const std::string &text) {
+    autocomplete_selected_index = index;
+  };
+
   autocomplete.get_tooltip = [this](unsigned int index) {
-    return autocomplete_comment[index];
+    auto it = autocomplete_resolved_comments.find(index);
+    if(it != autocomplete_resolved_comments.end())
+      return it->second;
+    resolve_completion_item(index);
+    return autocomplete_items.get(autocomplete_items.comments[index]);
   };
 }
 
+void Source::LanguageProtocolView::resolve_completion_item(unsigned int index) {
+  if(!capabilities.completion_resolve || autocomplete_show_parameters || index >= autocomplete_items.size())
+    return;
+  auto data = autocomplete_items.get(autocomplete_items.resolve_data[index]);
+  if(data.empty())
+    return;
+
+  // The rows of autocomplete are cleared when added to the dialog, so the label is read from autocomplete_items
+  client->write_request(this, "completionItem/resolve", autocomplete_items.get_resolve_params(index), [this, index, data](const boost::property_tree::ptree &result, bool error) {
+    if(error)
+      return;
+    auto detail = result.get<std::string>("detail", "");
+    auto documentation = result.get<std::string>("documentation.value", result.get<std::string>("documentation", ""));
+    if(!documentation.empty() && documentation != detail) {
+      if(!detail.empty())
+        detail += "\n\n";
+      detail += documentation;
+    }
+    dispatcher.post([this, index, data = std::move(data), comment = std::move(detail)]() mutable {
+      // The completion items might have been replaced
+      if(index >= autocomplete_items.size() || autocomplete_items.get(autocomplete_items.resolve_data[index]) != data)
+        return;
+      autocomplete_resolved_comments[index] = std::move(comment);
+      if(index == autocomplete_selected_index && CompletionDialog::get() && CompletionDialog::get()->is_visible())
+        autocomplete.update_tooltip(index);
+    });
+  }, "completion_resolve");
+}
+
 bool Source::LanguageProtocolView::has_named_parameters() {
   if(language_id == "python") // TODO: add more languages that supports named parameters
     return true;
@@ -1523,7 +2312,10 @@ void Source::LanguageProtocolView::add_flow_coverage_tooltips(bool called_in_thr
   auto stdout_stream = std::make_shared<std::stringstream>();
   auto exit_status = Terminal::get().process(stdin_stream, *stdout_stream, flow_coverage_executable.string() + " coverage --json " + file_path.string(), "", &stderr_stream);
   auto f = [this, exit_status, stdout_stream] {
+    add_remaining_diagnostic_tooltips();
     clear_diagnostic_tooltips();
+    for(auto &pair : shown_diagnostics)
+      add_shown_diagnostic_tooltip(pair.second);
     num_flow_coverage_warnings = 0;
     for(auto &mark : flow_coverage_marks) {
       get_buffer()->delete_mark(mark.first);
@@ -1553,9 +2345,7 @@ void Source::LanguageProtocolView::add_flow_coverage_tooltips(bool called_in_thr
       catch(...) {
       }
     }
-    status_diagnostics = std::make_tuple(num_warnings + num_flow_coverage_warnings, num_errors, num_fix_its);
-    if(update_status_diagnostics)
-      update_status_diagnostics(this);
+    update_diagnostics_status();
   };
   if(called_in_thread)
     dispatcher.post(std::move(f));
@@ -2,12 +2,18 @@
 #include "autocomplete.h"
 #include "process.hpp"
 #include "source.h"
+#include <atomic>
 #include <boost/property_tree/json_parser.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
 #include <list>
 #include <map>
 #include <mutex>
+#include <queue>
 #include <set>
 #include <sstream>
+#include <unordered_map>
 
 namespace Source {
   class LanguageProtocolView;
@@ -63,9 +69,10 @@ namespace LanguageProtocol {
     enum class TextDocumentSync { NONE = 0,
                                   FULL,
                                   INCREMENTAL };
-    TextDocumentSync text_document_sync;
+    TextDocumentSync text_document_sync = TextDocumentSync::NONE;
     bool hover;
     bool completion;
+    bool completion_resolve = false;
     bool signature_help;
     bool definition;
     bool references;
@@ -75,10 +82,133 @@ namespace LanguageProtocol {
     bool document_formatting;
     bool document_range_formatting;
     bool rename;
+    bool semantic_tokens = false;
+    bool semantic_tokens_delta = false;
+    /// Token types of the semantic tokens legend, indexed by the token type integers
+    std::vector<std::string> semantic_token_types;
+  };
+
+  /// Semantic tokens of a document, kept in the relative integer encoding of textDocument/semanticTokens
+  /// so that textDocument/semanticTokens/full/delta edits can be applied directly.
+  class SemanticTokens {
+  public:
+    class Token {
+    public:
+      int line;
+      int character;
+      int length;
+      int type;
+    };
+
+    class Edit {
+    public:
+      Edit(const boost::property_tree::ptree &pt);
+      size_t start;
+      size_t delete_count;
+      std::vector<int> data;
+    };
+
+    static std::vector<int> read_data(const boost::property_tree::ptree &pt);
+
+    std::string result_id;
+    /// Five integers per token: delta line, delta start character, length, token type and token modifiers
+    std::vector<int> data;
+    /// Decoded tokens, sorted on position
+    std::vector<Token> tokens;
+
+    void set(std::vector<int> &&data);
+    /// Returns the changed tokens as an index range [first, last) in tokens.
+    /// Throws std::out_of_range on edits outside of data.
+    std::pair<size_t, size_t> apply(std::vector<Edit> &&edits);
+
+  private:
+    void decode();
+  };
+
+  /// Maps between UTF-16 code unit positions, used by language servers, and character offsets on each line.
+  /// Only characters outside of the Basic Multilingual Plane differ, so each line stores the offsets of those characters.
+  /// Lines are indexed on first lookup, and edited lines are indexed again on their next lookup.
+  class Utf16Index {
+  public:
+    void reset(int line_count);
+    int get_line_count() const { return static_cast<int>(lines.size()); }
+    /// Call after inserting text at line that added new_lines lines
+    void insert(int line, int new_lines);
+    /// Call after erasing text starting at line that removed removed_lines lines
+    void erase(int line, int removed_lines);
+
+    /// get_line_text is called to index a line that is not yet indexed
+    int get_offset(int line, int utf16_pos, const std::function<std::string(int line)> &get_line_text);
+    int get_utf16_pos(int line, int offset, const std::function<std::string(int line)> &get_line_text);
+    /// Returns the byte index in the UTF-8 text of a line, without line ending, of the given UTF-16 position
+    static int get_line_index(const std::string &line, int utf16_pos);
+
+  private:
+    class Line {
+    public:
+      bool indexed = false;
+      /// Character offsets of the characters that are two UTF-16 code units
+      std::vector<int> surrogate_pair_offsets;
+    };
+    std::vector<Line> lines;
+    const std::vector<int> &get_surrogate_pair_offsets(int line, const std::function<std::string(int line)> &get_line_text);
+  };
+
+  /// Completion items in struct-of-arrays form, with the strings of all items stored in one buffer
+  class CompletionItems {
+  public:
+    class String {
+    public:
+      size_t offset;
+      size_t size;
+    };
+
+    std::vector<String> labels;
+    std::vector<String> inserts;
+    std::vector<String> comments;
+    /// The data field of each item as JSON, sent back in completionItem/resolve. Empty if the items are not resolved.
+    std::vector<String> resolve_data;
+
+    size_t size() const { return inserts.size(); }
+    void clear();
+    void emplace_back(const std::string &label, const std::string &insert, const std::string &comment, const std::string &data = {});
+    std::string get(const String &string) const { return buffer.substr(string.offset, string.size); }
+    /// Returns the parameters of a completionItem/resolve request for the item at index: the label and data of the item
+    std::string get_resolve_params(size_t index) const;
+
+  private:
+    std::string buffer;
+    String add(const std::string &string);
+  };
+
+  /// Splits language server output into message contents using the Content-Length headers.
+  /// Message contents are passed directly from the internal buffer, and consumed bytes are removed once per write.
+  class MessageFramer {
+  public:
+    void write(const char *bytes, size_t n, const std::function<void(const char *content, size_t size)> &on_message);
+
+  private:
+    std::string buffer;
+    size_t content_pos = 0;
+    size_t content_size = static_cast<size_t>(-1);
+  };
+
+  /// Response, request or notification from a language server
+  class Message {
+  public:
+    /// Throws std::runtime_error on invalid JSON
+    Message(const char *content, size_t size);
+    size_t id = 0;
+    std::string method;
+    bool has_result = false, has_error = false, has_params = false;
+    boost::property_tree::ptree result, error, params;
   };
 
   class Client {
     Client(std::string root_uri, std::string language_id);
+    /// Returns the client of the project or directory of file_path, and creates it if create is true and there is none.
+    /// Returns nullptr if create is false and there is no such client.
+    static std::shared_ptr<Client> get(const boost::filesystem::path &file_path, const std::string &language_id, bool create);
     std::string root_uri;
     std::string language_id;
 
@@ -92,19 +222,35 @@ namespace LanguageProtocol {
     std::unique_ptr<TinyProcessLib::Process> process;
     std::mutex read_write_mutex;
 
-    std::stringstream server_message_stream;
-    size_t server_message_size = static_cast<size_t>(-1);
-    size_t server_message_content_pos;
-    bool header_read = false;
+    MessageFramer message_framer;
 
     size_t message_id = 1;
 
     std::map<size_t, std::pair<Source::LanguageProtocolView *, std::function<void(const boost::property_tree::ptree &, bool error)>>> handlers;
-    std::vector<std::thread> timeout_threads;
-    std::mutex timeout_threads_mutex;
+    /// Id of the latest request of each request class, with view and request class as key
+    std::map<std::pair<Source::LanguageProtocolView *, std::string>, size_t> latest_requests;
+    /// Ids of requests cancelled with $/cancelRequest that the server has not yet replied to, or that have not timed out
+    std::set<size_t> cancelled_ids;
+    /// Timeout deadlines and request ids, handled by timeout_thread.
+    /// All requests have the same timeout, so the deadlines are in increasing order.
+    std::queue<std::pair<std::chrono::steady_clock::time_point, size_t>> timeouts;
+    std::mutex timeouts_mutex;
+    std::condition_variable timeouts_condition_variable;
+    bool timeouts_stop = false;
+    std::thread timeout_thread;
 
   public:
     static std::shared_ptr<Client> get(const boost::filesystem::path &file_path, const std::string &language_id);
+    /// Starts and initializes the language server of the given project path and language in the background,
+    /// if enabled with Config::get().source.language_server_prestart. Must be called from the main thread.
+    static void prestart(const boost::filesystem::path &path, const std::string &language_id);
+    /// Keeps client, and thus its language server, alive for Config::get().source.language_server_grace_period seconds.
+    /// Must be called from the main thread.
+    static void keep_alive(std::shared_ptr<Client> client);
+
+    std::atomic<size_t> sent_requests = {0};
+    std::atomic<size_t> cancelled_requests = {0};
+    std::atomic<size_t> completed_requests = {0};
 
     ~Client();
 
@@ -112,10 +258,31 @@ namespace LanguageProtocol {
     Capabilities initialize(Source::LanguageProtocolView *view);
     void close(Source::LanguageProtocolView *view);
 
-    void parse_server_message();
-    void write_request(Source::LanguageProtocolView *view, const std::string &method, const std::string &params, std::function<void(const boost::property_tree::ptree &, bool)> &&function = nullptr);
+    void parse_server_message(const char *content, size_t size);
+    /// If request_class is not empty, an outstanding request of the same view and request class is cancelled,
+    /// and the handler of the cancelled request is not called.
+    void write_request(Source::LanguageProtocolView *view, const std::string &method, const std::string &params, std::function<void(const boost::property_tree::ptree &, bool)> &&function = nullptr, const std::string &request_class = {});
     void write_notification(const std::string &method, const std::string &params);
     void handle_server_request(const std::string &method, const boost::property_tree::ptree &params);
+
+    /// Adds handler of $/progress notifications with the given token, for instance partial results of requests with a partialResultToken.
+    /// The handler is called from the thread reading the language server output, and is not called after remove_progress_handler returns.
+    void add_progress_handler(const std::string &token, std::function<void(const boost::property_tree::ptree &value)> &&function);
+    void remove_progress_handler(const std::string &token);
+
+  private:
+    std::map<std::string, std::function<void(const boost::property_tree::ptree &value)>> progress_handlers;
+    std::mutex progress_handlers_mutex;
+
+    /// Frames and writes content to the language server. Requires read_write_mutex to be locked.
+    bool write_message(const std::string &content);
+
+    /// Raw traffic recording, enabled with Config::get().log.language_server_record_path.
+    /// Each record is a line with direction ('>' to server or '<' from server), microseconds since start and size, followed by the raw bytes and a newline.
+    std::unique_ptr<std::ofstream> record_stream;
+    std::mutex record_mutex;
+    std::chrono::steady_clock::time_point record_start_time;
+    void record(char direction, const char *bytes, size_t n);
   };
 } // namespace LanguageProtocol
 
@@ -130,9 +297,20 @@ namespace Source {
     void rename(const boost::filesystem::path &path) override;
     bool save() override;
 
+    void configure() override;
+
     void update_diagnostics(std::vector<LanguageProtocol::Diagnostic> &&diagnostics);
 
     Gtk::TextIter get_iter_at_line_pos(int line, int pos) override;
+    /// Returns the UTF-16 position of iter in its line
+    int get_line_pos(const Gtk::TextIter &iter);
+
+    /// Escapes text for use in a JSON string
+    static void escape_text(std::string &text);
+
+    /// Writes a request about this document, or calls function directly with a response cached for the current document version.
+    /// Responses are cached with method and key, for instance the request position, as key.
+    void write_cached_request(const std::string &method, const std::string &key, const std::string &params, std::function<void(const boost::property_tree::ptree &, bool)> &&function, const std::string &request_class = {});
 
   protected:
     void show_type_tooltips(const Gdk::Rectangle &rectangle) override;
@@ -147,23 +325,85 @@ namespace Source {
 
     size_t document_version = 1;
 
+    LanguageProtocol::Utf16Index utf16_index;
+    std::string get_line_text(int line);
+
+    /// Responses for response_cache_version, with method and key as key
+    std::map<std::pair<std::string, std::string>, std::shared_ptr<boost::property_tree::ptree>> response_cache;
+    size_t response_cache_version = 0;
+    std::mutex response_cache_mutex;
+    void clear_response_cache();
+
+    /// Content changes that are sent in one textDocument/didChange notification at the end of the current main loop iteration.
+    /// Only used if the server supports incremental text document synchronization.
+    std::string content_changes;
+    bool content_changed = false;
+    sigc::connection content_changes_connection;
+    /// Sends pending content changes. Should be called before writing requests that depend on the buffer.
+    void flush_content_changes();
+
     std::thread initialize_thread;
     Dispatcher dispatcher;
 
-    void setup_navigation_and_refactoring();
+    static const std::map<std::string, std::string> &semantic_token_styles();
+    /// Tags of the semantic token styles, with style name as key
+    std::map<std::string, Glib::RefPtr<Gtk::TextTag>> semantic_token_style_tags;
+    /// Tags of the server's semantic token types, or nullptr for token types without style
+    std::vector<Glib::RefPtr<Gtk::TextTag>> semantic_token_tags;
+    LanguageProtocol::SemanticTokens semantic_tokens;
+    /// Set if tokens were received for an outdated document version, so that all lines are retagged on the next update
+    bool semantic_tokens_outdated = false;
+    sigc::connection delayed_semantic_tokens_connection;
+    sigc::connection semantic_tokens_idle_connection;
+    void setup_semantic_tokens();
+    void request_semantic_tokens();
+    /// Retags the lines in the visible range first, and the remaining lines when idle
+    void update_semantic_tokens();
+    void update_semantic_tokens(int start_line, int end_line);
+
+    class ShownDiagnostic {
+    public:
+      std::shared_ptr<LanguageProtocol::Diagnostic> diagnostic;
+      bool tooltip_added = false;
+      Tooltips::iterator tooltip;
+    };
+    /// Latest diagnostics from the language server that are not yet applied
+    std::unique_ptr<std::vector<LanguageProtocol::Diagnostic>> pending_diagnostics;
+    std::mutex pending_diagnostics_mutex;
+    /// Diagnostics are applied at most once per diagnostics_interval
+    static const std::chrono::milliseconds diagnostics_interval;
+    std::chrono::steady_clock::time_point diagnostics_applied_time;
+    sigc::connection delayed_diagnostics_connection;
+    /// Adds the tooltips of diagnostics outside of the visible lines
+    sigc::connection diagnostics_idle_connection;
+    /// Shown diagnostics, with range, severity and messages as key
+    std::map<std::string, ShownDiagnostic> shown_diagnostics;
+    void apply_diagnostics();
+    void add_shown_diagnostic_tooltip(ShownDiagnostic &shown_diagnostic);
+    void add_remaining_diagnostic_tooltips();
+    /// Updates diagnostic_offsets and the status diagnostics after diagnostics have changed
+    void update_diagnostics_status();
 
-    void escape_text(std::string &text);
+    void setup_navigation_and_refactoring();
 
     void tag_similar_symbols();
 
+    /// Returns the declaration of the token at iter, with its index as a byte index in its line
     Offset get_declaration(const Gtk::TextIter &iter);
+    /// Converts a UTF-16 position in a line of file to a byte index, using the buffer of the file if it is open, or else the file on disk
+    static int get_line_index(const std::string &file, int line, int utf16_pos);
 
     Autocomplete autocomplete;
     void setup_autocomplete();
-    std::vector<std::string> autocomplete_comment;
-    std::vector<std::string> autocomplete_insert;
+    LanguageProtocol::CompletionItems autocomplete_items;
+    /// Comments of resolved completion items, with item index as key
+    std::unordered_map<size_t, std::string> autocomplete_resolved_comments;
+    unsigned int autocomplete_selected_index = 0;
+    void resolve_completion_item(unsigned int index);
     std::list<std::pair<Glib::RefPtr<Gtk::TextBuffer::Mark>, Glib::RefPtr<Gtk::TextBuffer::Mark>>> argument_marks;
     bool autocomplete_show_parameters = false;
+    /// UTF-16 position of the cursor when autocomplete was started
+    int autocomplete_character = 0;
     sigc::connection autocomplete_delayed_show_arguments_connection;
 
     bool has_named_parameters();
@@ -44,11 +44,15 @@ public:
   void show(const Gdk::Rectangle &rectangle, bool disregard_drawn = false);
   void show(bool disregard_drawn = false);
   void hide(const std::pair<int, int> &last_mouse_pos = {-1, -1}, const std::pair<int, int> &mouse_pos = {-1, -1});
+  using iterator = std::list<Tooltip>::iterator;
+
   void clear() { tooltip_list.clear(); };
+  void erase(iterator it) { tooltip_list.erase(it); }
 
   template <typename... Ts>
-  void emplace_back(Ts &&... params) {
+  iterator emplace_back(Ts &&... params) {
     tooltip_list.emplace_back(std::forward<Ts>(params)...);
+    return std::prev(tooltip_list.end());
   }
 
   std::function<void()> on_motion;
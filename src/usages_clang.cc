@@ -532,12 +532,8 @@ Usages::Clang::PathSet Usages::Clang::find_paths(const boost::filesystem::path &
     if(CompileCommands::is_header(path))
       paths.emplace(path);
     else if(CompileCommands::is_source(path)) {
-      for(auto &command : compile_commands.commands) {
-        if(filesystem::get_normal_path(command.file) == path) {
-          paths.emplace(path);
-          break;
-        }
-      }
+      if(!compile_commands.get_commands(path).empty())
+        paths.emplace(path);
     }
   }
 
@@ -8,9 +8,75 @@
 #include "menu.h"
 #include "notebook.h"
 #include "project.h"
+#include "project_files.h"
 #include "selection_dialog.h"
 #include "terminal.h"
 
+namespace {
+  /// Returns the directory of the current file, the opened directory or the current path, or an empty path if none is found
+  boost::filesystem::path get_search_path() {
+    if(auto view = Notebook::get().get_current_view())
+      return view->file_path.parent_path();
+    if(!Directories::get().path.empty())
+      return Directories::get().path;
+    boost::system::error_code ec;
+    auto current_path = boost::filesystem::current_path(ec);
+    if(ec)
+      return boost::filesystem::path();
+    return current_path;
+  }
+
+  /// Returns text with bytes that are not part of valid UTF-8 replaced by '?'
+  std::string make_valid_utf8(const std::string &text) {
+    std::string valid;
+    auto begin = text.data(), end = text.data() + text.size();
+    const gchar *invalid;
+    while(!g_utf8_validate(begin, end - begin, &invalid)) {
+      valid.append(begin, invalid);
+      valid += '?';
+      begin = invalid + 1;
+    }
+    valid.append(begin, end);
+    return valid;
+  }
+
+  /// Returns the line of a match as markup with the match in bold, without leading whitespace, and shortened if long
+  std::string get_match_markup(const FindInFiles::Match &match) {
+    const size_t max_before = 50, max_match = 200, max_after = 150;
+    auto &text = match.line_text;
+    auto is_continuation_byte = [&text](size_t pos) {
+      return pos < text.size() && (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80;
+    };
+
+    auto match_begin = std::min(match.index, text.size());
+    auto match_end = std::min(match_begin + std::min(match.size, max_match), text.size());
+    while(match_end > match_begin && is_continuation_byte(match_end))
+      --match_end;
+    auto begin = std::min(text.find_first_not_of(" \t"), match_begin);
+    std::string before_prefix, after_suffix;
+    if(match_begin - begin > max_before) {
+      begin = match_begin - max_before;
+      while(begin < match_begin && is_continuation_byte(begin))
+        ++begin;
+      before_prefix = "…";
+    }
+    auto end = text.size();
+    if(match_end < match_begin + match.size)
+      end = match_end;
+    else if(end - match_end > max_after) {
+      end = match_end + max_after;
+      while(end > match_end && is_continuation_byte(end))
+        --end;
+    }
+    if(end < text.size())
+      after_suffix = "…";
+
+    return before_prefix + Glib::Markup::escape_text(make_valid_utf8(text.substr(begin, match_begin - begin))) +
+           "<b>" + Glib::Markup::escape_text(make_valid_utf8(text.substr(match_begin, match_end - match_begin))) + "</b>" +
+           Glib::Markup::escape_text(make_valid_utf8(text.substr(match_end, end - match_end))) + after_suffix;
+  }
+} // namespace
+
 Window::Window() {
   Gsv::init();
 
@@ -500,6 +566,9 @@ void Window::set_menu_actions() {
   menu.add_action("edit_find", [this]() {
     search_and_replace_entry();
   });
+  menu.add_action("edit_find_in_files", [this]() {
+    find_in_files_entry();
+  });
 
   menu.add_action("source_spellcheck", []() {
     if(auto view = Notebook::get().get_current_view()) {
@@ -620,29 +689,20 @@ void Window::set_menu_actions() {
     project->show_symbols();
   });
 
-  menu.add_action("source_find_file", []() {
+  menu.add_action("source_find_file", [this]() {
     auto view = Notebook::get().get_current_view();
 
-    boost::filesystem::path search_path;
-    if(view)
-      search_path = view->file_path.parent_path();
-    else if(!Directories::get().path.empty())
-      search_path = Directories::get().path;
-    else {
-      boost::system::error_code ec;
-      search_path = boost::filesystem::current_path(ec);
-      if(ec) {
-        Terminal::get().print("Error: could not find current path\n", true);
-        return;
-      }
+    auto search_path = get_search_path();
+    if(search_path.empty()) {
+      Terminal::get().print("Error: could not find current path\n", true);
+      return;
     }
-    auto build = Project::Build::create(search_path);
-    auto project_path = build->project_path;
-    boost::filesystem::path default_path, debug_path;
-    if(!project_path.empty()) {
-      search_path = project_path;
-      default_path = build->get_default_path();
-      debug_path = build->get_debug_path();
+    // The file list of a project is kept up to date in the background, and only listed the first time
+    auto project_files = ProjectFiles::get(search_path);
+    auto files = project_files->try_get_files();
+    if(files && files->empty()) {
+      Info::get().print("No files found in current project");
+      return;
     }
 
     if(view) {
@@ -652,38 +712,43 @@ void Window::set_menu_actions() {
     else
       SelectionDialog::create(true, true);
 
-    std::unordered_set<std::string> buffer_paths;
-    for(auto view : Notebook::get().get_views())
-      buffer_paths.emplace(view->file_path.string());
-
-    std::vector<boost::filesystem::path> paths;
-    // populate with all files in search_path
-    for(boost::filesystem::recursive_directory_iterator iter(search_path), end; iter != end; iter++) {
-      auto path = iter->path();
-      // ignore folders
-      if(!boost::filesystem::is_regular_file(path)) {
-        if(path == default_path || path == debug_path || path.filename() == ".git")
-          iter.no_push();
-        continue;
-      }
-
-      // remove project base path
-      auto row_str = filesystem::get_relative_path(path, search_path).string();
-      if(buffer_paths.count(path.string()))
-        row_str = "<b>" + row_str + "</b>";
-      paths.emplace_back(path);
-      SelectionDialog::get()->add_row(row_str);
+    auto buffer_paths = std::make_shared<std::unordered_set<std::string>>();
+    for(auto view : Notebook::get().get_views()) {
+      if(filesystem::file_in_path(view->file_path, project_files->project_path))
+        buffer_paths->emplace(filesystem::get_relative_path(view->file_path, project_files->project_path).string());
     }
 
-    if(paths.empty()) {
-      Info::get().print("No files found in current project");
-      return;
+    auto rows = std::make_shared<std::vector<boost::filesystem::path>>();
+    auto add_rows = [buffer_paths](std::vector<boost::filesystem::path> &rows, const std::vector<boost::filesystem::path> &files) {
+      for(auto &file : files) {
+        auto row_str = file.string();
+        if(buffer_paths->count(row_str))
+          row_str = "<b>" + row_str + "</b>";
+        rows.emplace_back(file);
+        SelectionDialog::get()->add_row(row_str);
+      }
+    };
+
+    // While the files are being listed, they are added to the dialog as they are found
+    std::shared_ptr<void> files_listener;
+    if(!files) {
+      files_listener = project_files->add_files_listener([this, rows = std::weak_ptr<std::vector<boost::filesystem::path>>(rows), add_rows](std::shared_ptr<const std::vector<boost::filesystem::path>> files) {
+        dispatcher.post([rows, add_rows, files = std::move(files)] {
+          auto locked_rows = rows.lock();
+          if(locked_rows && SelectionDialog::get() && SelectionDialog::get()->is_visible())
+            add_rows(*locked_rows, *files);
+        });
+      });
+      if(!files_listener)
+        files = project_files->try_get_files();
     }
+    if(files)
+      add_rows(*rows, *files);
 
-    SelectionDialog::get()->on_select = [paths = std::move(paths)](unsigned int index, const std::string &text, bool hide_window) {
-      if(index >= paths.size())
+    SelectionDialog::get()->on_select = [project_path = project_files->project_path, rows, files_listener](unsigned int index, const std::string &text, bool hide_window) {
+      if(index >= rows->size())
         return;
-      Notebook::get().open(paths[index]);
+      Notebook::get().open(project_path / (*rows)[index]);
       if(auto view = Notebook::get().get_current_view())
         view->hide_tooltips();
     };
@@ -710,9 +775,9 @@ void Window::set_menu_actions() {
             return;
           Notebook::get().open(offset.file_path);
           auto view = Notebook::get().get_current_view();
-          auto iter = view->get_iter_at_line_pos(offset.line, offset.index);
+          auto iter = view->get_iter_at_line_index(offset.line, offset.index);
           view->get_buffer()->insert(iter, std::get<1>(documentation_template));
-          iter = view->get_iter_at_line_pos(offset.line, offset.index);
+          iter = view->get_iter_at_line_index(offset.line, offset.index);
           iter.forward_chars(std::get<2>(documentation_template));
           view->get_buffer()->place_cursor(iter);
           view->scroll_to_cursor_delayed(view, true, false);
@@ -770,7 +835,7 @@ void Window::set_menu_actions() {
           auto view = Notebook::get().get_current_view();
           auto line = static_cast<int>(location.line);
           auto index = static_cast<int>(location.index);
-          view->place_cursor_at_line_pos(line, index);
+          view->place_cursor_at_line_index(line, index);
           view->scroll_to_cursor_delayed(view, true, false);
         }
       }
@@ -787,7 +852,7 @@ void Window::set_menu_actions() {
           auto view = Notebook::get().get_current_view();
           auto line = static_cast<int>(location.line);
           auto index = static_cast<int>(location.index);
-          view->place_cursor_at_line_pos(line, index);
+          view->place_cursor_at_line_index(line, index);
           view->scroll_to_cursor_delayed(view, true, false);
         }
       }
@@ -822,7 +887,7 @@ void Window::set_menu_actions() {
         auto view = Notebook::get().get_current_view();
         auto line = static_cast<int>(location.line);
         auto index = static_cast<int>(location.index);
-        view->place_cursor_at_line_pos(line, index);
+        view->place_cursor_at_line_index(line, index);
         view->scroll_to_cursor_delayed(view, true, false);
         return;
       }
@@ -834,7 +899,7 @@ void Window::set_menu_actions() {
           return;
         Notebook::get().open(location.file_path);
         auto view = Notebook::get().get_current_view();
-        view->place_cursor_at_line_pos(location.line, location.index);
+        view->place_cursor_at_line_index(location.line, location.index);
         view->scroll_to_cursor_delayed(view, true, false);
       };
       view->hide_tooltips();
@@ -893,7 +958,7 @@ void Window::set_menu_actions() {
               return;
             Notebook::get().open(offset.file_path);
             auto view = Notebook::get().get_current_view();
-            view->place_cursor_at_line_pos(offset.line, offset.index);
+            view->place_cursor_at_line_index(offset.line, offset.index);
             view->scroll_to_cursor_delayed(view, true, false);
           };
           view->hide_tooltips();
@@ -921,7 +986,7 @@ void Window::set_menu_actions() {
             if(index >= rows.size())
               return;
             auto offset = rows[index];
-            view->get_buffer()->place_cursor(view->get_iter_at_line_pos(offset.line, offset.index));
+            view->get_buffer()->place_cursor(view->get_iter_at_line_index(offset.line, offset.index));
             view->scroll_to(view->get_buffer()->get_insert(), 0.0, 1.0, 0.5);
             view->hide_tooltips();
           };
@@ -977,8 +1042,8 @@ void Window::set_menu_actions() {
         auto fix_its = view->get_fix_its();
         std::vector<std::pair<Glib::RefPtr<Gtk::TextMark>, Glib::RefPtr<Gtk::TextMark>>> fix_it_marks;
         for(auto &fix_it : fix_its) {
-          auto start_iter = view->get_iter_at_line_pos(fix_it.offsets.first.line, fix_it.offsets.first.index);
-          auto end_iter = view->get_iter_at_line_pos(fix_it.offsets.second.line, fix_it.offsets.second.index);
+          auto start_iter = view->get_iter_at_line_index(fix_it.offsets.first.line, fix_it.offsets.first.index);
+          auto end_iter = view->get_iter_at_line_index(fix_it.offsets.second.line, fix_it.offsets.second.index);
           fix_it_marks.emplace_back(buffer->create_mark(start_iter), buffer->create_mark(end_iter));
         }
         size_t c = 0;
@@ -1539,6 +1604,144 @@ void Window::search_and_replace_entry() {
   EntryBox::get().show();
 }
 
+void Window::find_in_files_entry() {
+  EntryBox::get().clear();
+  if(auto view = Notebook::get().get_current_view()) {
+    auto selected = view->get_selected_text();
+    if(!selected.empty() && selected.find('\n') == std::string::npos)
+      last_find_in_files = selected;
+  }
+  EntryBox::get().entries.emplace_back(last_find_in_files, [this](const std::string &content) {
+    last_find_in_files = content;
+    if(content.empty())
+      return;
+
+    auto search_path = get_search_path();
+    if(search_path.empty()) {
+      Terminal::get().print("Error: could not find current path\n", true);
+      return;
+    }
+
+    cancel_find_in_files();
+    try {
+      find_in_files = std::make_unique<FindInFiles>(content, case_sensitive_search, regex_search);
+    }
+    catch(const std::regex_error &e) {
+      Info::get().print("Invalid regular expression: " + std::string(e.what()));
+      return;
+    }
+
+    auto project_files = ProjectFiles::get(search_path);
+    auto project_path = project_files->project_path;
+    // Modified buffers are searched instead of the files on disk
+    std::map<boost::filesystem::path, std::string> buffers;
+    for(auto view : Notebook::get().get_views()) {
+      if(view->get_buffer()->get_modified() && filesystem::file_in_path(view->file_path, project_path))
+        buffers.emplace(view->file_path, view->get_buffer()->get_text().raw());
+    }
+
+    auto view = Notebook::get().get_current_view();
+    if(view) {
+      auto dialog_iter = view->get_iter_for_dialog();
+      SelectionDialog::create(view, view->get_buffer()->create_mark(dialog_iter), true, true);
+    }
+    else
+      SelectionDialog::create(true, true);
+
+    // Owned by the dialog, and expired when the dialog is replaced
+    auto rows = std::make_shared<std::vector<Source::Offset>>();
+    std::weak_ptr<std::vector<Source::Offset>> rows_weak = rows;
+    SelectionDialog::get()->on_select = [rows](unsigned int index, const std::string &text, bool hide_window) {
+      if(index >= rows->size())
+        return;
+      auto offset = (*rows)[index];
+      if(!boost::filesystem::is_regular_file(offset.file_path))
+        return;
+      Notebook::get().open(offset.file_path);
+      auto view = Notebook::get().get_current_view();
+      view->place_cursor_at_line_index(offset.line, offset.index);
+      view->scroll_to_cursor_delayed(view, true, false);
+      view->hide_tooltips();
+    };
+    SelectionDialog::get()->on_hide = [this] {
+      cancel_find_in_files();
+    };
+
+    // The matches are streamed to the dialog, which is shown when the first matches are found
+    auto search = [this, project_path, buffers = std::move(buffers), rows_weak](std::shared_ptr<const std::vector<boost::filesystem::path>> files) mutable {
+      find_in_files->search(project_path, std::move(files), std::move(buffers), [this, project_path, rows_weak](const boost::filesystem::path &file, std::vector<FindInFiles::Match> &&matches) {
+        auto file_markup = Glib::Markup::escape_text(make_valid_utf8(file.string()));
+        std::vector<std::string> markups;
+        markups.reserve(matches.size());
+        for(auto &match : matches)
+          markups.emplace_back(file_markup + ":" + std::to_string(match.line + 1) + ": " + get_match_markup(match));
+        dispatcher.post([this, file_path = project_path / file, matches = std::move(matches), markups = std::move(markups), rows_weak] {
+          auto rows = rows_weak.lock();
+          if(!rows || !find_in_files)
+            return;
+          for(size_t c = 0; c < matches.size(); ++c) {
+            rows->emplace_back(matches[c].line, matches[c].index, file_path);
+            SelectionDialog::get()->add_row(markups[c]);
+          }
+          if(!SelectionDialog::get()->is_visible()) {
+            if(auto view = Notebook::get().get_current_view())
+              view->hide_tooltips();
+            SelectionDialog::get()->show();
+          }
+        });
+      }, [this, rows_weak] {
+        dispatcher.post([this, rows_weak] {
+          auto rows = rows_weak.lock();
+          if(rows && rows->empty() && find_in_files)
+            Info::get().print("No matches found");
+        });
+      });
+    };
+    if(auto files = project_files->try_get_files())
+      search(std::move(files));
+    else {
+      // The files are waited for in a separate thread, since listing the files of a large directory takes time
+      std::thread files_thread([this, project_files = std::move(project_files), search = std::move(search), rows_weak, find_in_files_ptr = find_in_files.get()]() mutable {
+        auto files = project_files->get_files();
+        dispatcher.post([this, files = std::move(files), search = std::move(search), rows_weak, find_in_files_ptr]() mutable {
+          if(rows_weak.lock() && find_in_files && find_in_files.get() == find_in_files_ptr)
+            search(std::move(files));
+        });
+      });
+      files_thread.detach();
+    }
+    EntryBox::get().hide();
+  });
+  auto entry_it = EntryBox::get().entries.begin();
+  entry_it->set_placeholder_text("Find in files");
+  EntryBox::get().buttons.emplace_back("Find", [entry_it]() {
+    entry_it->activate();
+  });
+
+  EntryBox::get().toggle_buttons.emplace_back("Aa");
+  EntryBox::get().toggle_buttons.back().set_tooltip_text("Match Case");
+  EntryBox::get().toggle_buttons.back().set_active(case_sensitive_search);
+  EntryBox::get().toggle_buttons.back().on_activate = [this]() {
+    case_sensitive_search = !case_sensitive_search;
+  };
+  EntryBox::get().toggle_buttons.emplace_back(".*");
+  EntryBox::get().toggle_buttons.back().set_tooltip_text("Use Regex");
+  EntryBox::get().toggle_buttons.back().set_active(regex_search);
+  EntryBox::get().toggle_buttons.back().on_activate = [this]() {
+    regex_search = !regex_search;
+  };
+  EntryBox::get().show();
+}
+
+void Window::cancel_find_in_files() {
+  if(auto find_in_files_ptr = find_in_files.release()) {
+    std::thread delete_thread([find_in_files_ptr] {
+      delete find_in_files_ptr; // Stops the search, and waits for the worker threads to finish
+    });
+    delete_thread.detach();
+  }
+}
+
 void Window::set_tab_entry() {
   EntryBox::get().clear();
   if(auto view = Notebook::get().get_current_view()) {
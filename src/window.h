@@ -1,4 +1,6 @@
 #pragma once
+#include "dispatcher.h"
+#include "find_in_files.h"
 #include <atomic>
 #include <boost/filesystem.hpp>
 #include <gtkmm.h>
@@ -28,14 +30,22 @@ private:
   void configure();
   void set_menu_actions();
   void search_and_replace_entry();
+  void find_in_files_entry();
   void set_tab_entry();
   void goto_line_entry();
   void rename_token_entry();
   std::string last_search;
   std::string last_replace;
+  std::string last_find_in_files;
   std::string last_run_command;
   std::string last_run_debug_command;
   bool case_sensitive_search = true;
   bool regex_search = false;
   bool search_entry_shown = false;
+
+  Dispatcher dispatcher;
+  /// The search in progress, if any, whose matches are shown in SelectionDialog
+  std::unique_ptr<FindInFiles> find_in_files;
+  /// Resets find_in_files, and stops its search in a separate thread, since the worker threads might be searching large files
+  void cancel_find_in_files();
 };
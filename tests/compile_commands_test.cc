@@ -1,5 +1,8 @@
 #include "compile_commands.h"
+#include "filesystem.h"
+#include <algorithm>
 #include <glib.h>
+#include <thread>
 
 int main() {
   auto tests_path = boost::filesystem::canonical(JUCI_TESTS_PATH);
@@ -32,5 +35,58 @@ int main() {
     g_assert_cmpuint(compile_commands.commands.size(), ==, 1);
 
     g_assert_cmpstr(compile_commands.commands.at(0).parameters.at(2).c_str(), ==, "-Wall");
+
+    auto commands = compile_commands.get_commands(tests_path / "source_clang_test_files" / "main.cpp");
+    g_assert_cmpuint(commands.size(), ==, 1);
+    g_assert(commands.at(0) == &compile_commands.commands.at(0));
+    g_assert_cmpuint(compile_commands.get_commands(tests_path / "source_clang_test_files" / "test.cpp").size(), ==, 0);
+
+    // Database is shared between CompileCommands objects with the same build path
+    CompileCommands compile_commands2(tests_path / "source_clang_test_files" / "build");
+    g_assert(&compile_commands2.commands == &compile_commands.commands);
+  }
+
+  {
+    auto build_path = tests_path / "source_clang_test_files" / "build";
+    auto arguments = CompileCommands::get_arguments(build_path, tests_path / "source_clang_test_files" / "main.cpp");
+    g_assert(std::find(arguments.begin(), arguments.end(), "-Wall") != arguments.end());
+    g_assert(std::find(arguments.begin(), arguments.end(), "-o") == arguments.end());
+    g_assert(std::find(arguments.begin(), arguments.end(), "main.cpp") == arguments.end());
+    g_assert(CompileCommands::get_arguments(build_path, tests_path / "source_clang_test_files" / "main.cpp") == arguments);
+  }
+
+  {
+    auto project_path = tests_path / "tmp" / "compile_commands_test";
+    auto build_path = project_path / "build";
+    boost::filesystem::create_directories(build_path);
+    boost::filesystem::create_directories(project_path / "include");
+    filesystem::write(project_path / "main.cpp", "#include \"test.hpp\"\nint main() {}\n");
+    filesystem::write(project_path / "include" / "test.hpp", "#pragma once\n  #  include <test2.hpp>\n");
+    filesystem::write(project_path / "include" / "test2.hpp", "#pragma once\n");
+    filesystem::write(project_path / "include" / "test3.hpp", "#pragma once\n");
+    filesystem::write(build_path / "compile_commands.json", R"([
+{
+  "directory": ")" + build_path.string() + R"(",
+  "command": "c++ -I../include -DTEST_DEFINE -o main.cpp.o -c ../main.cpp",
+  "file": "../main.cpp"
+}
+])");
+
+    auto has_test_define = [&build_path](const boost::filesystem::path &path) {
+      auto arguments = CompileCommands::get_arguments(build_path, path);
+      return std::find(arguments.begin(), arguments.end(), "-DTEST_DEFINE") != arguments.end();
+    };
+
+    g_assert(has_test_define(project_path / "main.cpp"));
+
+    // Header arguments are inferred after the include index has been built in the background
+    auto header_path = project_path / "include" / "test2.hpp";
+    for(size_t c = 0; c < 1000 && !has_test_define(header_path); ++c)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    g_assert(has_test_define(header_path));
+    g_assert(has_test_define(project_path / "include" / "test.hpp"));
+    g_assert(!has_test_define(project_path / "include" / "test3.hpp"));
+
+    boost::filesystem::remove_all(project_path);
   }
 }
@@ -0,0 +1,92 @@
+#include "ctags.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+
+// Measures tag line parsing throughput on a captured tags file, for instance created with:
+// ctags --fields=ns --sort=foldcase -I "override noexcept" -f tags -R *
+// Usage: ctags_benchmark <tags file>
+
+double microseconds_since(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  if(argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <tags file>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream stream(argv[1], std::ifstream::binary);
+  if(!stream) {
+    std::cerr << "Could not open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::string tags(std::istreambuf_iterator<char>(stream), (std::istreambuf_iterator<char>()));
+
+  std::vector<std::pair<size_t, size_t>> lines;
+  for(size_t start = 0, end; start < tags.size(); start = end + 1) {
+    end = tags.find('\n', start);
+    if(end == std::string::npos)
+      end = tags.size();
+    if(tags[start] != '!') // Skip pseudo-tags of tags files
+      lines.emplace_back(start, end - start);
+  }
+  if(lines.empty()) {
+    std::cerr << "No tags in " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << lines.size() << " tag lines, " << tags.size() << " bytes" << std::endl;
+
+  auto report = [&](const std::string &name, double time) {
+    std::cout << name << ": " << time * 1000.0 / lines.size() << " ns/line, " << tags.size() / time << " MB/s" << std::endl;
+  };
+
+  for(auto markup : {false, true}) {
+    size_t symbols_size = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto &line : lines)
+      symbols_size += Ctags::get_location(&tags[line.first], line.second, markup).symbol.size();
+    report(markup ? "get_location with markup" : "get_location", microseconds_since(start));
+    if(symbols_size == 0)
+      std::cerr << "Warning: no symbols parsed" << std::endl;
+  }
+
+  {
+    // The regular expression previously used in get_location, for comparison
+    const static std::regex regex(R"(^([^\t]+)\t([^\t]+)\t(?:/\^)?([ \t]*)(.+?)(\$/)?;"\tline:([0-9]+)\t?[a-zA-Z]*:?(.*)$)");
+    size_t matches = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto &line : lines) {
+      auto begin = tags.data() + line.first;
+      std::cmatch sm;
+      if(std::regex_match(begin, begin + line.second, sm, regex))
+        ++matches;
+    }
+    report("regex_match", microseconds_since(start));
+    if(matches != lines.size())
+      std::cerr << "Warning: " << lines.size() - matches << " lines not matched by regex" << std::endl;
+  }
+
+  {
+    // Symbol lookups through binary search, which requires a tags file sorted with --sort=foldcase
+    Ctags::Tags sorted_tags(tags);
+    std::vector<std::string> symbols;
+    for(size_t c = 0; c < lines.size(); c += 100)
+      symbols.emplace_back(tags.substr(lines[c].first, tags.find('\t', lines[c].first) - lines[c].first));
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto &symbol : symbols) {
+      auto range = sorted_tags.find(symbol);
+      if(range.first != range.second)
+        ++found;
+    }
+    std::cout << "Tags::find: " << microseconds_since(start) / symbols.size() << " µs/lookup" << std::endl;
+    if(found != symbols.size())
+      std::cerr << "Warning: " << symbols.size() - found << " symbols not found, the tags file might not be sorted" << std::endl;
+  }
+}
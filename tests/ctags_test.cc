@@ -0,0 +1,73 @@
+#include "ctags.h"
+#include <glib.h>
+
+int main() {
+  {
+    auto location = Ctags::get_location("main\tsrc/main.cpp\t/^int main() {$/;\"\tline:3", false);
+    g_assert(location);
+    g_assert_cmpstr(location.symbol.c_str(), ==, "main");
+    g_assert(location.file_path == "src/main.cpp");
+    g_assert_cmpuint(location.line, ==, 2);
+    g_assert_cmpuint(location.index, ==, 4);
+    g_assert_cmpstr(location.source.c_str(), ==, "int main() {");
+    g_assert(location.scope.empty());
+  }
+  {
+    auto location = Ctags::get_location("Foo\tfoo.hpp\t/^  class Foo : public Bar<Foo> {$/;\"\tline:10\tnamespace:A::B", true);
+    g_assert_cmpstr(location.symbol.c_str(), ==, "Foo");
+    g_assert_cmpuint(location.line, ==, 9);
+    g_assert_cmpuint(location.index, ==, 8);
+    g_assert_cmpstr(location.source.c_str(), ==, "class <b>Foo</b> : public Bar&lt;<b>Foo</b>&gt; {");
+    g_assert_cmpstr(location.scope.c_str(), ==, "A::B");
+  }
+  {
+    auto location = Ctags::get_location("operator <\ta.cpp\t/^bool operator < (const A &a) {$/;\"\tline:20\tclass:A", false);
+    g_assert_cmpstr(location.symbol.c_str(), ==, "operator<");
+    g_assert_cmpuint(location.index, ==, 0);
+    g_assert_cmpstr(location.scope.c_str(), ==, "A");
+  }
+  {
+    auto location = Ctags::get_location("operator new\ta.cpp\t/^void *operator new(size_t size) {$/;\"\tline:21\tclass:A", false);
+    g_assert_cmpstr(location.symbol.c_str(), ==, "operator new");
+    g_assert_cmpuint(location.index, ==, 6);
+  }
+  {
+    auto location = Ctags::get_location("MACRO\ta.h\t12;\"\tline:12", true);
+    g_assert_cmpuint(location.line, ==, 11);
+    g_assert_cmpuint(location.index, ==, 0);
+    g_assert_cmpstr(location.source.c_str(), ==, "<b>MACRO</b>");
+  }
+  {
+    std::string line = "x\ta.h\t/^\tint x;$/;\"\tline:1\tfunction:f\nnext line";
+    auto location = Ctags::get_location(line.data(), line.find('\n'), false);
+    g_assert_cmpstr(location.source.c_str(), ==, "int x;");
+    g_assert_cmpuint(location.index, ==, 5);
+    g_assert_cmpstr(location.scope.c_str(), ==, "f");
+  }
+  {
+    auto location = Ctags::get_location("not a tag line", false);
+    g_assert(!location);
+  }
+
+  {
+    Ctags::Tags tags("a\tx.h\t1;\"\tline:1\n"
+                     "B\tx.h\t2;\"\tline:2\n"
+                     "b\tx.h\t3;\"\tline:3\n"
+                     "bb\tx.h\t4;\"\tline:4\n"
+                     "operator <\tx.h\t5;\"\tline:5\n"
+                     "operator()\tx.h\t6;\"\tline:6\n"
+                     "z\tx.h\t7;\"\tline:7\n");
+    auto range = tags.find("b");
+    g_assert_cmpstr(std::string(range.first, range.second).c_str(), ==, "B\tx.h\t2;\"\tline:2\nb\tx.h\t3;\"\tline:3\n");
+    range = tags.find("operator", true);
+    g_assert_cmpstr(std::string(range.first, range.second).c_str(), ==, "operator <\tx.h\t5;\"\tline:5\noperator()\tx.h\t6;\"\tline:6\n");
+    range = tags.find("a");
+    g_assert(range.first == tags.data() && std::string(range.first, range.second) == "a\tx.h\t1;\"\tline:1\n");
+    range = tags.find("z");
+    g_assert(range.second == tags.data() + tags.size() && range.second - range.first == 17);
+    range = tags.find("c");
+    g_assert(range.first == range.second);
+    range = tags.find("0");
+    g_assert(range.first == range.second && range.first == tags.data());
+  }
+}
@@ -0,0 +1,93 @@
+#include "filesystem.h"
+#include "find_in_files.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+// Measures searching the files in a directory, for instance a large source tree.
+// Usage: find_in_files_benchmark <directory> [pattern...]
+// Patterns starting with (?i) are case insensitive, and patterns starting with (?r) are regular expressions.
+
+double milliseconds_since(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  if(argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <directory> [pattern...]" << std::endl;
+    return 1;
+  }
+
+  boost::filesystem::path project_path(argv[1]);
+  auto files = std::make_shared<std::vector<boost::filesystem::path>>();
+  boost::system::error_code ec;
+  for(boost::filesystem::recursive_directory_iterator it(project_path, ec), end; it != end; it.increment(ec)) {
+    if(it->path().filename() == ".git") {
+      it.no_push();
+      continue;
+    }
+    if(boost::filesystem::is_regular_file(it->symlink_status(ec)))
+      files->emplace_back(filesystem::get_relative_path(it->path(), project_path));
+  }
+  if(files->empty()) {
+    std::cerr << "No files in " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> patterns;
+  for(int c = 2; c < argc; ++c)
+    patterns.emplace_back(argv[c]);
+  if(patterns.empty())
+    patterns = {"include", "(?i)include", "std::vector", "xyzq", "(?r)std::(vector|map)<", "(?i)(?r)todo:"};
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << files->size() << " files" << std::endl;
+
+  for(auto &pattern : patterns) {
+    auto text = pattern;
+    bool case_sensitive = true, regex = false;
+    if(text.compare(0, 4, "(?i)") == 0) {
+      case_sensitive = false;
+      text.erase(0, 4);
+    }
+    if(text.compare(0, 4, "(?r)") == 0) {
+      regex = true;
+      text.erase(0, 4);
+    }
+    std::cout << '"' << pattern << '"' << std::endl;
+
+    if(case_sensitive && !regex) {
+      // Reading lines with std::getline and using std::string::find, for comparison
+      size_t lines = 0;
+      auto start = std::chrono::steady_clock::now();
+      for(auto &file : *files) {
+        std::ifstream stream((project_path / file).string(), std::ifstream::binary);
+        std::string line;
+        while(std::getline(stream, line)) {
+          if(line.find(text) != std::string::npos)
+            ++lines;
+        }
+      }
+      std::cout << "  getline and find: " << milliseconds_since(start) << " ms, " << lines << " lines" << std::endl;
+    }
+
+    FindInFiles find_in_files(text, case_sensitive, regex);
+    {
+      size_t lines = 0;
+      auto start = std::chrono::steady_clock::now();
+      for(auto &file : *files)
+        lines += find_in_files.find(project_path / file).size();
+      std::cout << "  FindInFiles::find: " << milliseconds_since(start) << " ms, " << lines << " lines" << std::endl;
+    }
+    {
+      size_t lines = 0;
+      auto start = std::chrono::steady_clock::now();
+      find_in_files.search(project_path, files, {}, [&lines](const boost::filesystem::path &file, std::vector<FindInFiles::Match> &&matches) {
+        lines += matches.size();
+      });
+      find_in_files.wait();
+      std::cout << "  FindInFiles::search: " << milliseconds_since(start) << " ms, " << lines << " lines" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,136 @@
+#include "find_in_files.h"
+#include <glib.h>
+
+int main() {
+  auto tests_path = boost::filesystem::canonical(JUCI_TESTS_PATH);
+
+  {
+    FindInFiles find_in_files("test");
+    std::string text = "a test\r\nno match\n\ntest, test\nTest\ntes";
+    auto matches = find_in_files.find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 2);
+    g_assert_cmpuint(matches[0].line, ==, 0);
+    g_assert_cmpuint(matches[0].index, ==, 2);
+    g_assert_cmpuint(matches[0].size, ==, 4);
+    g_assert_cmpstr(matches[0].line_text.c_str(), ==, "a test");
+    g_assert_cmpuint(matches[1].line, ==, 3);
+    g_assert_cmpuint(matches[1].index, ==, 0);
+    g_assert_cmpstr(matches[1].line_text.c_str(), ==, "test, test");
+  }
+  {
+    FindInFiles find_in_files("TeSt", false);
+    std::string text = "test\nTEST\nno\natest";
+    auto matches = find_in_files.find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 3);
+    g_assert_cmpuint(matches[1].line, ==, 1);
+    g_assert_cmpuint(matches[2].line, ==, 3);
+    g_assert_cmpuint(matches[2].index, ==, 1);
+    g_assert_cmpstr(matches[2].line_text.c_str(), ==, "atest");
+
+    // A match after many occurrences of the other case of the first letter
+    text = std::string(10000, 'T') + "est";
+    matches = find_in_files.find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 1);
+    g_assert_cmpuint(matches[0].index, ==, 9999);
+  }
+  {
+    std::string text = "int a;\n";
+    text += '\0';
+    text += "int b;\n";
+    g_assert(FindInFiles("int").find(text.data(), text.size()).empty());
+  }
+  {
+    FindInFiles find_in_files(R"(\w+\(\))", true, true);
+    std::string text = "void f();\n\nf();\r\nno match";
+    auto matches = find_in_files.find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 2);
+    g_assert_cmpuint(matches[0].index, ==, 5);
+    g_assert_cmpuint(matches[0].size, ==, 3);
+    g_assert_cmpuint(matches[1].line, ==, 2);
+    g_assert_cmpstr(matches[1].line_text.c_str(), ==, "f();");
+
+    matches = FindInFiles("^[a-z]+$", false, true).find(text.data(), text.size());
+    g_assert(matches.empty());
+    matches = FindInFiles("^NO", false, true).find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 1);
+    g_assert_cmpuint(matches[0].line, ==, 3);
+  }
+  {
+    // Lines not containing a string that every match contains are not passed to std::regex
+    std::string text = "std::map<int, int> a;\nstd::vector<int> b;\nstd::set<int> c;\nvector<int> d;\nSTD::VECTOR<int> e;";
+    auto matches = FindInFiles("std::(vector|map)<", true, true).find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 2);
+    g_assert_cmpuint(matches[1].line, ==, 1);
+    g_assert_cmpuint(matches[1].size, ==, 12);
+    matches = FindInFiles("std::(vector|map)<", false, true).find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 3);
+    g_assert_cmpuint(matches[2].line, ==, 4);
+    g_assert_cmpuint(FindInFiles("set|^vector", true, true).find(text.data(), text.size()).size(), ==, 2);
+    g_assert_cmpuint(FindInFiles(R"(st?d::\w+<int>)", true, true).find(text.data(), text.size()).size(), ==, 2);
+  }
+  {
+    // std::regex is run on parts of long lines, since it could otherwise overflow the stack
+    std::string text = "ab" + std::string(5000, 'a') + "\n" + std::string(5000, 'a') + "b\n";
+    auto matches = FindInFiles("a.*b", true, true).find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 2);
+    g_assert_cmpuint(matches[0].line, ==, 0);
+    g_assert_cmpuint(matches[0].size, ==, 2);
+    g_assert_cmpuint(matches[1].line, ==, 1);
+    g_assert(FindInFiles("^a+$", true, true).find(text.data(), text.size()).empty());
+
+    text = std::string(1500, ' ') + "foo123bar x " + std::string(1500, ' ') + "\n" + std::string(499, ' ') + "foo456bar";
+    matches = FindInFiles(R"(foo\d+bar)", true, true).find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 2);
+    g_assert_cmpuint(matches[0].index, ==, 1500);
+    g_assert_cmpuint(matches[0].size, ==, 9);
+    g_assert_cmpuint(matches[1].index, ==, 499);
+    matches = FindInFiles(R"(\bfoo\d+)", true, true).find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 2);
+    g_assert_cmpuint(matches[0].index, ==, 1500);
+
+    // A match across the boundary of two windows
+    text = std::string(990, ' ') + "foo123bar" + std::string(1000, ' ');
+    matches = FindInFiles(R"(foo\d+bar)", true, true).find(text.data(), text.size());
+    g_assert_cmpuint(matches.size(), ==, 1);
+    g_assert_cmpuint(matches[0].index, ==, 990);
+  }
+  {
+    bool exception = false;
+    try {
+      FindInFiles("(", true, true);
+    }
+    catch(const std::regex_error &) {
+      exception = true;
+    }
+    g_assert(exception);
+  }
+  {
+    auto files = std::make_shared<std::vector<boost::filesystem::path>>();
+    files->emplace_back("find_in_files_test.cc");
+    files->emplace_back("fuzzy_match_test.cc");
+    files->emplace_back("json_test.cc");
+    files->emplace_back("does_not_exist.cc");
+    std::map<boost::filesystem::path, std::string> buffers;
+    buffers.emplace(tests_path / "json_test.cc", "int main() {}\n\n// fuzzy_match_test.cc\n");
+
+    std::vector<boost::filesystem::path> matched_files;
+    std::vector<std::vector<FindInFiles::Match>> file_matches;
+    bool done = false;
+    FindInFiles find_in_files("fuzzy_match_test.cc");
+    find_in_files.search(tests_path, files, std::move(buffers), [&](const boost::filesystem::path &file, std::vector<FindInFiles::Match> &&matches) {
+      g_assert(!done);
+      matched_files.emplace_back(file);
+      file_matches.emplace_back(std::move(matches));
+    }, [&done] {
+      done = true;
+    });
+    find_in_files.wait();
+    g_assert(done);
+    g_assert_cmpuint(matched_files.size(), ==, 2);
+    g_assert(matched_files[0] == "find_in_files_test.cc");
+    g_assert(matched_files[1] == "json_test.cc");
+    g_assert_cmpuint(file_matches[1].size(), ==, 1);
+    g_assert_cmpuint(file_matches[1][0].line, ==, 2);
+    g_assert_cmpuint(file_matches[1][0].index, ==, 3);
+  }
+}
@@ -0,0 +1,89 @@
+#include "fuzzy_match.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+// Measures row filtering on a captured list of rows, one row per line, for instance created with:
+// git ls-files > rows
+// Usage: fuzzy_match_benchmark <rows file> [query...]
+
+double microseconds_since(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  if(argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <rows file> [query...]" << std::endl;
+    return 1;
+  }
+
+  std::ifstream stream(argv[1], std::ifstream::binary);
+  if(!stream) {
+    std::cerr << "Could not open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::vector<std::string> rows;
+  std::string line;
+  while(std::getline(stream, line)) {
+    if(!line.empty())
+      rows.emplace_back(std::move(line));
+  }
+  if(rows.empty()) {
+    std::cerr << "No rows in " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> queries;
+  for(int c = 2; c < argc; ++c)
+    queries.emplace_back(argv[c]);
+  if(queries.empty())
+    queries = {"s", "src", "main", "dlg", "selection_dialog", "xyzq"};
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << rows.size() << " rows" << std::endl;
+
+  FuzzyMatcher matcher;
+  auto start = std::chrono::steady_clock::now();
+  for(auto &row : rows)
+    matcher.add(row);
+  std::cout << "add: " << microseconds_since(start) / 1000.0 << " ms" << std::endl;
+
+  const size_t iterations = 10;
+  for(auto &query : queries) {
+    std::cout << '"' << query << '"' << std::endl;
+
+    {
+      // The substring filter previously used in SelectionDialog, for comparison
+      size_t matches = 0;
+      auto start = std::chrono::steady_clock::now();
+      for(size_t i = 0; i < iterations; ++i) {
+        matches = 0;
+        for(auto &row : rows) {
+          auto row_lc = row;
+          auto query_lc = query;
+          std::transform(row_lc.begin(), row_lc.end(), row_lc.begin(), ::tolower);
+          std::transform(query_lc.begin(), query_lc.end(), query_lc.begin(), ::tolower);
+          if(row_lc.find(query_lc) != std::string::npos)
+            ++matches;
+        }
+      }
+      std::cout << "  lowercase and find: " << microseconds_since(start) / iterations / 1000.0 << " ms, " << matches << " matches" << std::endl;
+    }
+
+    for(auto max_results : {static_cast<size_t>(100), std::numeric_limits<size_t>::max()}) {
+      std::vector<unsigned int> indices;
+      auto start = std::chrono::steady_clock::now();
+      for(size_t i = 0; i < iterations; ++i)
+        indices = matcher.find(query, max_results);
+      std::cout << "  FuzzyMatcher::find";
+      if(max_results != std::numeric_limits<size_t>::max())
+        std::cout << " (top " << max_results << ")";
+      std::cout << ": " << microseconds_since(start) / iterations / 1000.0 << " ms, " << indices.size() << " matches";
+      if(!indices.empty())
+        std::cout << ", best: " << rows[indices[0]];
+      std::cout << std::endl;
+    }
+  }
+}
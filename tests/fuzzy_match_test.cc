@@ -0,0 +1,69 @@
+#include "fuzzy_match.h"
+#include <glib.h>
+
+int main() {
+  {
+    g_assert_cmpint(FuzzyMatcher::score("", "anything"), ==, 0);
+    g_assert_cmpint(FuzzyMatcher::score("abc", "aXbXc"), !=, FuzzyMatcher::no_match);
+    g_assert_cmpint(FuzzyMatcher::score("ABC", "xaxbxc"), !=, FuzzyMatcher::no_match);
+    g_assert_cmpint(FuzzyMatcher::score("abc", "acb"), ==, FuzzyMatcher::no_match);
+    g_assert_cmpint(FuzzyMatcher::score("abc", "ab"), ==, FuzzyMatcher::no_match);
+    g_assert_cmpint(FuzzyMatcher::score("a", ""), ==, FuzzyMatcher::no_match);
+  }
+  {
+    // Word boundaries, camelCase humps and path separators
+    g_assert_cmpint(FuzzyMatcher::score("gn", "get_name"), >, FuzzyMatcher::score("gn", "signal"));
+    g_assert_cmpint(FuzzyMatcher::score("gn", "getName"), >, FuzzyMatcher::score("gn", "gainful"));
+    g_assert_cmpint(FuzzyMatcher::score("main", "src/main.cc"), >, FuzzyMatcher::score("main", "src/domain.cc"));
+    g_assert_cmpint(FuzzyMatcher::score("sd", "src/dialogs.cc"), >, FuzzyMatcher::score("sd", "source_diff.cc"));
+    // Consecutive characters, and the shortest match in a row
+    g_assert_cmpint(FuzzyMatcher::score("dia", "dialogs"), >, FuzzyMatcher::score("dia", "d_i_a"));
+    g_assert_cmpint(FuzzyMatcher::score("ab", "a_____ab"), ==, FuzzyMatcher::score("ab", "_ab"));
+    // Exact case
+    g_assert_cmpint(FuzzyMatcher::score("Foo", "Foo"), >, FuzzyMatcher::score("Foo", "foo"));
+  }
+  {
+    FuzzyMatcher matcher;
+    matcher.add("src/selection_dialog.cc");
+    matcher.add("src/source.cc");
+    matcher.add("tests/source_test.cc");
+    matcher.add("src/dialogs.cc");
+    matcher.add("src/source.h");
+    g_assert_cmpuint(matcher.size(), ==, 5);
+
+    auto indices = matcher.find("");
+    g_assert_cmpuint(indices.size(), ==, 5);
+    g_assert_cmpuint(indices[4], ==, 4);
+
+    indices = matcher.find("source");
+    g_assert_cmpuint(indices.size(), ==, 3);
+    g_assert_cmpuint(indices[0], ==, 4); // Same score as src/source.cc, but shorter
+    g_assert_cmpuint(indices[1], ==, 1);
+    g_assert_cmpuint(indices[2], ==, 2);
+
+    indices = matcher.find("source", 2);
+    g_assert_cmpuint(indices.size(), ==, 2);
+    g_assert_cmpuint(indices[1], ==, 1);
+
+    indices = matcher.find("dlg");
+    g_assert_cmpuint(indices.size(), ==, 2);
+
+    g_assert(matcher.find("xyz").empty());
+
+    g_assert_cmpuint(matcher.find("s", 10, [] { return false; }).size(), ==, 5);
+    g_assert(matcher.find("s", 10, [] { return true; }).empty());
+
+    matcher.clear();
+    g_assert_cmpuint(matcher.size(), ==, 0);
+    g_assert(matcher.find("").empty());
+  }
+  {
+    FuzzyMatcher matcher;
+    matcher.add("a.cc:3: <b>std::vector&lt;int&gt;</b> v;", true);
+    matcher.add("b.cc:4: bold", true);
+    g_assert(matcher.find("vector<int>").size() == 1);
+    g_assert(matcher.find("&lt;").empty());
+    g_assert(matcher.find("bold").size() == 1);
+    g_assert(matcher.find("b>").empty());
+  }
+}
@@ -23,6 +23,10 @@ int main() {
     g_assert_cmpuint(lines.added.size(), ==, 1);
     g_assert_cmpuint(lines.modified.size(), ==, 1);
     g_assert_cmpuint(lines.removed.size(), ==, 1);
+
+    g_assert(!repository->is_ignored(boost::filesystem::path("tests") / "git_test.cc"));
+    g_assert(!repository->is_ignored("tests", true));
+    g_assert(repository->is_ignored(boost::filesystem::path("tests") / "libtest.so"));
   }
   catch(const std::exception &e) {
     std::cerr << e.what() << std::endl;
@@ -0,0 +1,79 @@
+#include "json.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <glib.h>
+#include <sstream>
+
+int main() {
+  {
+    std::string text = R"( {"a": [1, -2.5e3, true, null, "te\"st"], "b": {"c": "æ😀\n"}, "d": {}, "e": []} )";
+    boost::property_tree::ptree pt;
+    JSONReader reader(text);
+    reader.read(pt);
+    g_assert(reader.at_end());
+
+    boost::property_tree::ptree expected_pt;
+    std::stringstream stream(text);
+    boost::property_tree::read_json(stream, expected_pt);
+    g_assert(pt == expected_pt);
+
+    auto it = pt.get_child("a").begin();
+    g_assert_cmpint(it->second.get_value<int>(), ==, 1);
+    ++it;
+    g_assert_cmpstr(it->second.get_value<std::string>().c_str(), ==, "-2.5e3");
+    ++it;
+    g_assert(it->second.get_value<bool>());
+    ++it;
+    g_assert_cmpstr(it->second.get_value<std::string>().c_str(), ==, "null");
+    ++it;
+    g_assert_cmpstr(it->second.get_value<std::string>().c_str(), ==, "te\"st");
+    g_assert_cmpstr(pt.get<std::string>("b.c").c_str(), ==, "\xc3\xa6\xf0\x9f\x98\x80\n");
+  }
+
+  {
+    std::string text = R"({"skipped": {"a": [1, {"b": "]}"}]}, "string": "value"})";
+    JSONReader reader(text);
+    reader.expect('{');
+    std::string key, value;
+    reader.read_string(key);
+    g_assert_cmpstr(key.c_str(), ==, "skipped");
+    reader.expect(':');
+    reader.skip_value();
+    g_assert(reader.consume(','));
+    reader.read_string(key);
+    reader.expect(':');
+    reader.read_string(value);
+    g_assert_cmpstr(value.c_str(), ==, "value");
+    reader.expect('}');
+    g_assert(reader.at_end());
+  }
+
+  {
+    bool exception_thrown = false;
+    try {
+      boost::property_tree::ptree pt;
+      JSONReader reader(std::string(R"({"a": "b)"));
+      reader.read(pt);
+    }
+    catch(const std::runtime_error &) {
+      exception_thrown = true;
+    }
+    g_assert(exception_thrown);
+  }
+
+  {
+    std::string text = R"([{"data": {"a": [], "b": "1"} }, {"data": "te\"st"}, {"data": [1, 2]}])";
+    boost::property_tree::ptree pt;
+    JSONReader reader(text);
+    reader.raw_key = "data";
+    reader.read(pt);
+    g_assert(reader.at_end());
+    auto it = pt.begin();
+    g_assert_cmpstr(it->second.get_child("data").data().c_str(), ==, R"({"a": [], "b": "1"})");
+    g_assert_cmpstr(it->second.get<std::string>("data.b").c_str(), ==, "1");
+    ++it;
+    g_assert_cmpstr(it->second.get_child("data").data().c_str(), ==, R"("te\"st")");
+    ++it;
+    g_assert_cmpstr(it->second.get_child("data").data().c_str(), ==, "[1, 2]");
+    g_assert_cmpint(it->second.get_child("data").size(), ==, 2);
+  }
+}
@@ -0,0 +1,140 @@
+#include "config.h"
+#include "source_language_protocol.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Measures language server message handling using a recording made with the log.language_server_record_path setting.
+// Usage: language_protocol_benchmark <recording> [source file [language id]]
+// If a source file is given, it is opened in a LanguageProtocolView served by replay-language-server (the recording should be made on the same file),
+// and the recorded server messages are dispatched again to measure dispatch and UI-thread time.
+
+void flush_events() {
+  while(Gtk::Main::events_pending())
+    Gtk::Main::iteration(false);
+}
+
+double microseconds_since(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  if(argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <recording> [source file [language id]]" << std::endl;
+    return 1;
+  }
+
+  std::ifstream stream(argv[1], std::ifstream::binary);
+  if(!stream) {
+    std::cerr << "Could not open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::vector<std::string> chunks;
+  size_t total_size = 0;
+  std::string line;
+  while(std::getline(stream, line)) {
+    if(line.empty())
+      continue;
+    char direction;
+    long long time;
+    size_t size;
+    std::istringstream line_stream(line);
+    if(!(line_stream >> direction >> time >> size)) {
+      std::cerr << "Invalid record: " << line << std::endl;
+      return 1;
+    }
+    std::string bytes(size, '\0');
+    stream.read(&bytes[0], size);
+    if(direction == '<') {
+      total_size += size;
+      chunks.emplace_back(std::move(bytes));
+    }
+  }
+
+  std::vector<std::string> contents;
+  LanguageProtocol::MessageFramer message_framer;
+  for(auto &chunk : chunks) {
+    message_framer.write(chunk.data(), chunk.size(), [&contents](const char *content, size_t size) {
+      contents.emplace_back(content, size);
+    });
+  }
+  if(contents.empty()) {
+    std::cerr << "No server messages in " << argv[1] << std::endl;
+    return 1;
+  }
+
+  const size_t iterations = 1000;
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << contents.size() << " server messages, " << total_size << " bytes, " << iterations << " iterations" << std::endl;
+
+  {
+    size_t messages = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; ++i) {
+      LanguageProtocol::MessageFramer message_framer;
+      for(auto &chunk : chunks)
+        message_framer.write(chunk.data(), chunk.size(), [&messages](const char *, size_t) { ++messages; });
+    }
+    auto time = microseconds_since(start);
+    std::cout << "framing: " << time / messages << " µs/message, " << (total_size * iterations) / time << " MB/s" << std::endl;
+  }
+
+  {
+    size_t messages = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; ++i) {
+      LanguageProtocol::MessageFramer message_framer;
+      for(auto &chunk : chunks) {
+        message_framer.write(chunk.data(), chunk.size(), [&messages](const char *content, size_t size) {
+          try {
+            LanguageProtocol::Message message(content, size);
+            ++messages;
+          }
+          catch(...) {
+          }
+        });
+      }
+    }
+    auto time = microseconds_since(start);
+    std::cout << "framing and parsing: " << time / messages << " µs/message, " << (total_size * iterations) / time << " MB/s" << std::endl;
+  }
+
+  if(argc < 3)
+    return 0;
+
+  auto app = Gtk::Application::create();
+  Gsv::init();
+
+  Config::get().log.language_server = false;
+  Glib::setenv("JUCI_LANGUAGE_SERVER_RECORDING", argv[1]);
+  Glib::setenv("PATH", std::string(JUCI_BUILD_PATH) + "/tests:" + Glib::getenv("PATH"));
+
+  auto file_path = boost::filesystem::canonical(argv[2]);
+  auto language = Source::guess_language(file_path);
+  std::string language_id = argc >= 4 ? argv[3] : "replay";
+
+  auto start = std::chrono::steady_clock::now();
+  auto view = new Source::LanguageProtocolView(file_path, language, language_id);
+  while(view->status_state == "initializing...")
+    flush_events();
+  std::cout << "view initialization: " << microseconds_since(start) / 1000.0 << " ms" << std::endl;
+
+  double dispatch_time = 0.0, ui_time = 0.0;
+  const size_t view_iterations = 100;
+  for(size_t i = 0; i < view_iterations; ++i) {
+    start = std::chrono::steady_clock::now();
+    for(auto &content : contents)
+      view->client->parse_server_message(content.data(), content.size());
+    dispatch_time += microseconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    flush_events();
+    ui_time += microseconds_since(start);
+  }
+  std::cout << "dispatch: " << dispatch_time / (contents.size() * view_iterations) << " µs/message" << std::endl;
+  std::cout << "UI thread: " << ui_time / view_iterations / 1000.0 << " ms/iteration" << std::endl;
+
+  delete view;
+}
@@ -0,0 +1,215 @@
+#include "config.h"
+#include "source_language_protocol.h"
+#include <future>
+#include <glib.h>
+
+int main() {
+  auto tests_path = boost::filesystem::canonical(JUCI_TESTS_PATH);
+  Config::get().log.language_server = false;
+
+  {
+    std::vector<std::string> contents;
+    LanguageProtocol::MessageFramer message_framer;
+    auto on_message = [&contents](const char *content, size_t size) {
+      contents.emplace_back(content, size);
+    };
+
+    std::string messages = "Content-Length: 14\r\n\r\n{\"id\":1,\"a\":2}"
+                           "Content-Length: 3\r\nContent-Type: application/vscode-jsonrpc; charset=utf-8\r\n\r\n[1]"
+                           "Content-Length: 2\r\n\r\n{}";
+
+    // Write one byte at a time
+    for(auto &chr : messages)
+      message_framer.write(&chr, 1, on_message);
+    g_assert_cmpuint(contents.size(), ==, 3);
+    g_assert_cmpstr(contents[0].c_str(), ==, "{\"id\":1,\"a\":2}");
+    g_assert_cmpstr(contents[1].c_str(), ==, "[1]");
+    g_assert_cmpstr(contents[2].c_str(), ==, "{}");
+
+    // Write all at once
+    contents.clear();
+    message_framer.write(messages.data(), messages.size(), on_message);
+    g_assert_cmpuint(contents.size(), ==, 3);
+    g_assert_cmpstr(contents[1].c_str(), ==, "[1]");
+
+    // Write partial message
+    contents.clear();
+    message_framer.write(messages.data(), 40, on_message);
+    g_assert_cmpuint(contents.size(), ==, 1);
+    message_framer.write(messages.data() + 40, messages.size() - 40, on_message);
+    g_assert_cmpuint(contents.size(), ==, 3);
+    g_assert_cmpstr(contents[2].c_str(), ==, "{}");
+  }
+
+  {
+    std::string content = R"({"jsonrpc":"2.0","id":3,"result":{"items":[{"label":"test","data":{"a":[],"b":"1"}}]}})";
+    LanguageProtocol::Message message(content.data(), content.size());
+    g_assert_cmpuint(message.id, ==, 3);
+    g_assert(message.has_result);
+    g_assert(!message.has_error);
+    g_assert_cmpstr(message.result.get_child("items").begin()->second.get<std::string>("label").c_str(), ==, "test");
+    g_assert_cmpstr(message.result.get_child("items").begin()->second.get_child("data").data().c_str(), ==, R"({"a":[],"b":"1"})");
+  }
+
+  {
+    std::string content = R"({"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":"file:///test","diagnostics":[]}})";
+    LanguageProtocol::Message message(content.data(), content.size());
+    g_assert_cmpuint(message.id, ==, 0);
+    g_assert_cmpstr(message.method.c_str(), ==, "textDocument/publishDiagnostics");
+    g_assert(message.has_params);
+    g_assert_cmpstr(message.params.get<std::string>("uri").c_str(), ==, "file:///test");
+  }
+
+  // Semantic tokens
+  {
+    LanguageProtocol::SemanticTokens semantic_tokens;
+    // Tokens at 0:4, 0:10, 2:2 and 2:8
+    semantic_tokens.set({0, 4, 3, 1, 0,
+                         0, 6, 5, 2, 0,
+                         2, 2, 4, 1, 0,
+                         0, 6, 1, 3, 0});
+    g_assert_cmpuint(semantic_tokens.tokens.size(), ==, 4);
+    g_assert_cmpint(semantic_tokens.tokens[1].line, ==, 0);
+    g_assert_cmpint(semantic_tokens.tokens[1].character, ==, 10);
+    g_assert_cmpint(semantic_tokens.tokens[1].length, ==, 5);
+    g_assert_cmpint(semantic_tokens.tokens[2].line, ==, 2);
+    g_assert_cmpint(semantic_tokens.tokens[2].character, ==, 2);
+    g_assert_cmpint(semantic_tokens.tokens[3].character, ==, 8);
+    g_assert_cmpint(semantic_tokens.tokens[3].type, ==, 3);
+
+    // Replace the second token with two tokens on line 1
+    boost::property_tree::ptree edit;
+    std::stringstream stream(R"({"start":5,"deleteCount":5,"data":[1,0,2,4,0,0,3,2,4,0]})");
+    boost::property_tree::read_json(stream, edit);
+    std::vector<LanguageProtocol::SemanticTokens::Edit> edits;
+    edits.emplace_back(edit);
+    auto changed = semantic_tokens.apply(std::move(edits));
+    g_assert_cmpuint(changed.first, ==, 1);
+    g_assert_cmpuint(changed.second, ==, 3);
+    g_assert_cmpuint(semantic_tokens.tokens.size(), ==, 5);
+    g_assert_cmpint(semantic_tokens.tokens[1].line, ==, 1);
+    g_assert_cmpint(semantic_tokens.tokens[1].character, ==, 0);
+    g_assert_cmpint(semantic_tokens.tokens[2].line, ==, 1);
+    g_assert_cmpint(semantic_tokens.tokens[2].character, ==, 3);
+    g_assert_cmpint(semantic_tokens.tokens[3].line, ==, 3);
+    g_assert_cmpint(semantic_tokens.tokens[4].character, ==, 8);
+
+    edits.clear();
+    stream = std::stringstream(R"({"start":100,"deleteCount":5})");
+    boost::property_tree::read_json(stream, edit);
+    edits.emplace_back(edit);
+    bool thrown = false;
+    try {
+      semantic_tokens.apply(std::move(edits));
+    }
+    catch(const std::out_of_range &) {
+      thrown = true;
+    }
+    g_assert(thrown);
+  }
+
+  // UTF-16 positions
+  {
+    std::vector<std::string> lines = {"a\xc3\xa6" "b", "\xf0\x9f\x98\x80" "b" "\xf0\x9f\x98\x80" "c", "abc"}; // "aæb", "😀b😀c", "abc"
+    int get_line_text_calls = 0;
+    auto get_line_text = [&lines, &get_line_text_calls](int line) {
+      ++get_line_text_calls;
+      return lines[line];
+    };
+    LanguageProtocol::Utf16Index utf16_index;
+    utf16_index.reset(lines.size());
+    g_assert_cmpint(utf16_index.get_offset(0, 2, get_line_text), ==, 2);
+    g_assert_cmpint(utf16_index.get_offset(1, 2, get_line_text), ==, 1);
+    g_assert_cmpint(utf16_index.get_offset(1, 3, get_line_text), ==, 2);
+    g_assert_cmpint(utf16_index.get_offset(1, 5, get_line_text), ==, 3);
+    g_assert_cmpint(utf16_index.get_offset(1, 6, get_line_text), ==, 4);
+    g_assert_cmpint(utf16_index.get_utf16_pos(1, 0, get_line_text), ==, 0);
+    g_assert_cmpint(utf16_index.get_utf16_pos(1, 1, get_line_text), ==, 2);
+    g_assert_cmpint(utf16_index.get_utf16_pos(1, 3, get_line_text), ==, 5);
+    g_assert_cmpint(get_line_text_calls, ==, 2);
+
+    // Insert a line with a surrogate pair after the first line
+    lines.insert(lines.begin() + 1, "\xf0\x9f\x98\x80");
+    utf16_index.insert(0, 1);
+    g_assert_cmpint(utf16_index.get_line_count(), ==, 4);
+    g_assert_cmpint(utf16_index.get_utf16_pos(1, 1, get_line_text), ==, 2);
+    g_assert_cmpint(utf16_index.get_offset(2, 3, get_line_text), ==, 2);
+    g_assert_cmpint(get_line_text_calls, ==, 3);
+
+    // Erase the two first lines
+    lines.erase(lines.begin(), lines.begin() + 2);
+    utf16_index.erase(0, 2);
+    g_assert_cmpint(utf16_index.get_line_count(), ==, 2);
+    g_assert_cmpint(utf16_index.get_offset(0, 3, get_line_text), ==, 2);
+    g_assert_cmpint(utf16_index.get_offset(1, 2, get_line_text), ==, 2);
+
+    // Byte indexes of UTF-16 positions
+    g_assert_cmpint(LanguageProtocol::Utf16Index::get_line_index("a\xc3\xa6" "b", 2), ==, 3);
+    g_assert_cmpint(LanguageProtocol::Utf16Index::get_line_index("\xf0\x9f\x98\x80" "b" "\xf0\x9f\x98\x80" "c", 0), ==, 0);
+    g_assert_cmpint(LanguageProtocol::Utf16Index::get_line_index("\xf0\x9f\x98\x80" "b" "\xf0\x9f\x98\x80" "c", 2), ==, 4);
+    g_assert_cmpint(LanguageProtocol::Utf16Index::get_line_index("\xf0\x9f\x98\x80" "b" "\xf0\x9f\x98\x80" "c", 5), ==, 9);
+    g_assert_cmpint(LanguageProtocol::Utf16Index::get_line_index("\xf0\x9f\x98\x80" "b" "\xf0\x9f\x98\x80" "c", 7), ==, 10);
+  }
+
+  // Completion items
+  {
+    LanguageProtocol::CompletionItems items;
+    items.emplace_back("insert", "insert(${1:})", "comment", R"({"id":1})");
+    items.emplace_back("insert2", "insert2", "");
+    g_assert_cmpuint(items.size(), ==, 2);
+    g_assert(items.get(items.labels[0]) == "insert");
+    g_assert(items.get(items.inserts[0]) == "insert(${1:})");
+    g_assert(items.get(items.comments[0]) == "comment");
+    g_assert(items.get(items.resolve_data[0]) == R"({"id":1})");
+    g_assert(items.get(items.inserts[1]) == "insert2");
+    g_assert(items.get(items.comments[1]).empty());
+    g_assert(items.get(items.resolve_data[1]).empty());
+    g_assert(items.get_resolve_params(0) == R"("label":"insert","data":{"id":1})");
+    items.clear();
+    g_assert_cmpuint(items.size(), ==, 0);
+  }
+
+  // Replay recorded language server traffic
+  {
+    g_setenv("JUCI_LANGUAGE_SERVER_RECORDING", (tests_path / "language_protocol_test_files" / "replay.record").string().c_str(), true);
+    g_setenv("PATH", (std::string(JUCI_BUILD_PATH) + "/tests:" + g_getenv("PATH")).c_str(), true);
+
+    LanguageProtocol::Client client(tests_path.string(), "replay");
+    auto capabilities = client.initialize(nullptr);
+    g_assert(capabilities.text_document_sync == LanguageProtocol::Capabilities::TextDocumentSync::INCREMENTAL);
+    g_assert(capabilities.hover);
+    g_assert(capabilities.completion);
+    g_assert(!capabilities.document_highlight);
+
+    std::promise<std::string> hover;
+    client.write_request(nullptr, "textDocument/hover", "", [&hover](const boost::property_tree::ptree &result, bool error) {
+      hover.set_value(error ? std::string() : result.get<std::string>("contents.value", ""));
+    });
+    g_assert(hover.get_future().get() == "hover \xc3\xa6 text");
+
+    // The label and unchanged data of a completion item are sent back in completionItem/resolve
+    LanguageProtocol::CompletionItems items;
+    std::promise<void> completion;
+    client.write_request(nullptr, "textDocument/completion", "", [&items, &completion](const boost::property_tree::ptree &result, bool error) {
+      if(!error) {
+        for(auto &item : result.get_child("items")) {
+          auto label = item.second.get<std::string>("label");
+          items.emplace_back(label, label, "", item.second.get_child("data").data());
+        }
+      }
+      completion.set_value();
+    });
+    completion.get_future().get();
+    g_assert_cmpuint(items.size(), ==, 1);
+    auto resolve_params = items.get_resolve_params(0);
+    g_assert(resolve_params == R"("label":"test \"label\"","data":{"a":[],"b":"1"})");
+
+    std::promise<std::string> resolved;
+    client.write_request(nullptr, "completionItem/resolve", resolve_params, [&resolved](const boost::property_tree::ptree &result, bool error) {
+      resolved.set_value(error ? std::string() : result.get<std::string>("documentation.value", ""));
+    });
+    g_assert(resolved.get_future().get() == "resolved text");
+    g_assert_cmpuint(client.sent_requests, ==, 4);
+    g_assert_cmpuint(client.completed_requests, ==, 4);
+  }
+}
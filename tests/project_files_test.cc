@@ -0,0 +1,60 @@
+#include "filesystem.h"
+#include "project_files.h"
+#include <boost/filesystem.hpp>
+#include <glib.h>
+#include <gtkmm.h>
+#include <thread>
+
+int main() {
+  auto app = Gtk::Application::create();
+
+  auto tests_path = boost::filesystem::canonical(JUCI_TESTS_PATH);
+
+  {
+    auto project_path = tests_path / "tmp" / "project_files_test";
+    boost::filesystem::remove_all(project_path);
+    boost::filesystem::create_directories(project_path / "a");
+    boost::filesystem::create_directories(project_path / "i");
+    filesystem::write(project_path / "a" / "1.txt", "");
+    filesystem::write(project_path / "b.txt", "");
+    filesystem::write(project_path / "c.txt", "");
+    filesystem::write(project_path / "d.txt", "");
+    filesystem::write(project_path / "i" / "3.txt", "");
+
+    auto project_files = std::shared_ptr<ProjectFiles>(new ProjectFiles(project_path, {}, nullptr, false));
+    ProjectFiles::build(project_files);
+    g_assert(*project_files->get_files() == std::vector<boost::filesystem::path>({boost::filesystem::path("a") / "1.txt", "b.txt", "c.txt", "d.txt", boost::filesystem::path("i") / "3.txt"}));
+
+    // Create a file and a directory
+    filesystem::write(project_path / "e.txt", "");
+    boost::filesystem::create_directories(project_path / "f");
+    filesystem::write(project_path / "f" / "2.txt", "");
+    project_files->update(project_path / "e.txt");
+    project_files->update(project_path / "f");
+
+    // Delete a file and a directory
+    boost::filesystem::remove(project_path / "c.txt");
+    boost::filesystem::remove_all(project_path / "i");
+    project_files->update(project_path / "c.txt");
+    project_files->update(project_path / "i");
+
+    // Rename a file and a directory
+    boost::filesystem::rename(project_path / "d.txt", project_path / "g.txt");
+    boost::filesystem::rename(project_path / "a", project_path / "h");
+    project_files->update(project_path / "d.txt");
+    project_files->update(project_path / "g.txt");
+    project_files->update(project_path / "a");
+    project_files->update(project_path / "h");
+
+    auto updating = [&project_files] {
+      std::unique_lock<std::mutex> lock(project_files->mutex);
+      return project_files->updating;
+    };
+    for(size_t c = 0; c < 1000 && updating(); ++c)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    g_assert(!updating());
+    g_assert(*project_files->get_files() == std::vector<boost::filesystem::path>({"b.txt", "e.txt", boost::filesystem::path("f") / "2.txt", "g.txt", boost::filesystem::path("h") / "1.txt"}));
+
+    boost::filesystem::remove_all(project_path);
+  }
+}
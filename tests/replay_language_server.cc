@@ -0,0 +1,67 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Stand-in language server that replays a recording made with the log.language_server_record_path setting.
+// The recording path is read from the JUCI_LANGUAGE_SERVER_RECORDING environment variable.
+// A message is read from stdin for each recorded client message before the following server output is written.
+
+bool read_message() {
+  size_t content_size = static_cast<size_t>(-1);
+  std::string line;
+  while(std::getline(std::cin, line)) {
+    if(!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if(line.empty()) {
+      if(content_size == static_cast<size_t>(-1))
+        return false;
+      std::string content(content_size, '\0');
+      return static_cast<bool>(std::cin.read(&content[0], content_size));
+    }
+    if(line.compare(0, 15, "Content-Length:") == 0)
+      content_size = std::strtoul(line.c_str() + 15, nullptr, 10);
+  }
+  return false;
+}
+
+int main() {
+  auto path = std::getenv("JUCI_LANGUAGE_SERVER_RECORDING");
+  if(!path) {
+    std::cerr << "JUCI_LANGUAGE_SERVER_RECORDING is not set" << std::endl;
+    return 1;
+  }
+  std::ifstream stream(path, std::ifstream::binary);
+  if(!stream) {
+    std::cerr << "Could not open " << path << std::endl;
+    return 1;
+  }
+
+  std::ios::sync_with_stdio(false);
+
+  std::string line;
+  while(std::getline(stream, line)) {
+    if(line.empty())
+      continue;
+    char direction;
+    long long time;
+    size_t size;
+    std::istringstream line_stream(line);
+    if(!(line_stream >> direction >> time >> size)) {
+      std::cerr << "Invalid record: " << line << std::endl;
+      return 1;
+    }
+    std::string bytes(size, '\0');
+    stream.read(&bytes[0], size);
+
+    if(direction == '>') {
+      if(!read_message())
+        return 0;
+    }
+    else {
+      std::cout.write(bytes.data(), bytes.size());
+      std::cout.flush();
+    }
+  }
+}
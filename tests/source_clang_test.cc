@@ -33,6 +33,8 @@ int main() {
   while(!clang_view->parsed)
     flush_events();
   g_assert_cmpuint(clang_view->clang_diagnostics.size(), ==, 0);
+  g_assert(clang_view->inclusions_parsed);
+  g_assert_cmpuint(clang_view->inclusions.size(), ==, 0);
 
   //test get_declaration and get_implementation
   clang_view->place_cursor_at_line_index(15, 7);
@@ -205,6 +207,31 @@ namespace N {
     g_assert_cmpstr(method.c_str(), ==, "void N::T::f9() const {}");
   }
 
+  // Saving a header only reparses the views that include it
+  {
+    auto tests_path = boost::filesystem::canonical(std::string(JUCI_TESTS_PATH) + "/source_clang_test_files");
+    auto header_view = new Source::ClangView(tests_path / "header.hpp", Gsv::LanguageManager::get_default()->get_language("cpphdr"));
+    auto header_user_view = new Source::ClangView(tests_path / "header_user.cpp", Gsv::LanguageManager::get_default()->get_language("cpp"));
+    while(!header_view->parsed || !header_user_view->parsed || !clang_view->parsed)
+      flush_events();
+    g_assert(header_user_view->inclusions_parsed);
+    g_assert_cmpuint(header_user_view->inclusions.count((tests_path / "header.hpp").string()), ==, 1);
+    g_assert_cmpuint(clang_view->inclusions.count((tests_path / "header.hpp").string()), ==, 0);
+
+    clang_view->soft_reparse_needed = false;
+    header_user_view->soft_reparse_needed = false;
+    header_view->get_buffer()->set_modified(true);
+    g_assert(header_view->save());
+    g_assert(header_user_view->soft_reparse_needed);
+    g_assert(!clang_view->soft_reparse_needed);
+
+    header_view->async_delete();
+    header_view->delete_thread.join();
+    header_user_view->async_delete();
+    header_user_view->delete_thread.join();
+    flush_events();
+  }
+
   clang_view->async_delete();
   clang_view->delete_thread.join();
   flush_events();
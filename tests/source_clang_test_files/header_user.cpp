@@ -0,0 +1,5 @@
+#include "header.hpp"
+
+int header_user() {
+  return header_function();
+}